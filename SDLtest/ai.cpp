@@ -0,0 +1,122 @@
+#include "ai.h"
+#include <cmath>
+
+// Paddle step per tick, used as the dead zone so the paddle settles instead of oscillating
+static const float AI_DEAD_ZONE = 5.0f;
+
+// Function to draw a uniform number in [-1, 1] from the controller's xorshift state
+static float aiRandom(AiController& ai) {
+    unsigned x = ai.rngState;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    ai.rngState = x;
+    return static_cast<float>(x & 0xFFFFFF) / static_cast<float>(0x7FFFFF) - 1.0f;
+}
+
+// Function to fold an unbounded coordinate into [0, range] as a ball bouncing between 0 and range would
+static float foldReflections(float position, float range) {
+    float period = 2.0f * range;
+    float folded = std::fmod(position, period);
+    if (folded < 0) {
+        folded += period;
+    }
+    return folded > range ? period - folded : folded;
+}
+
+// Function to find where update() turns the ball around. It moves in whole steps and flips
+// velocity on the first position at or past a wall, so the turning points are the first
+// lattice points (start + n * step) at or beyond 0 and range rather than the walls themselves.
+static void latticeWalls(float start, float step, float range, float& low, float& high) {
+    float phase = std::fmod(start, step);
+    if (phase < 0) {
+        phase += step;
+    }
+    low = phase > 0 ? phase - step : 0;
+    high = phase + step * std::ceil((range - phase) / step);
+}
+
+void initAi(AiController& ai, int reactionTicks, float noise, unsigned seed) {
+    ai.enabled = true;
+    ai.reactionTicks = reactionTicks < 0 ? 0 : (reactionTicks > AI_MAX_REACTION_TICKS ? AI_MAX_REACTION_TICKS : reactionTicks);
+    ai.noise = noise;
+    ai.rngState = seed != 0 ? seed : 0x9E3779B9u;
+    ai.historyIndex = 0;
+    ai.historyCount = 0;
+    ai.aimOffset = 0;
+    ai.approaching = false;
+}
+
+float predictInterceptY(const Ball& ball, float faceX, bool leftSide) {
+    if (ball.dx == 0) {
+        return ball.y + ball.r;
+    }
+    // The ball's top-left corner stays inside these ranges, update() flips velocity at either end
+    float rangeX = static_cast<float>(SCREEN_WIDTH - 2 * ball.r);
+    float rangeY = static_cast<float>(SCREEN_HEIGHT - 2 * ball.r);
+    float speedX = std::fabs(ball.dx);
+    float lowX, highX;
+    latticeWalls(ball.x, speedX, rangeX, lowX, highX);
+
+    // Ticks until the ball first reaches the paddle face, going via the far side wall if moving away
+    float ticks;
+    if (leftSide) {
+        ticks = ball.dx < 0
+            ? std::ceil((ball.x - faceX) / speedX)
+            : (highX - ball.x) / speedX + std::ceil((highX - faceX) / speedX);
+    }
+    else {
+        ticks = ball.dx > 0
+            ? std::ceil((faceX - ball.x) / speedX)
+            : (ball.x - lowX) / speedX + std::ceil((faceX - lowX) / speedX);
+    }
+    if (ticks < 0) {
+        ticks = 0;
+    }
+
+    if (ball.dy == 0) {
+        return ball.y + ball.r;
+    }
+    float lowY, highY;
+    latticeWalls(ball.y, std::fabs(ball.dy), rangeY, lowY, highY);
+    return lowY + foldReflections(ball.y + ball.dy * ticks - lowY, highY - lowY) + ball.r;
+}
+
+// Function to tell a serve from ordinary movement: resetBall() puts the ball back in the middle,
+// much further than one tick's step from where it was
+static bool ballWasServed(const Ball& previous, const Ball& ball) {
+    return std::fabs(ball.x - previous.x) > std::fabs(previous.dx) + std::fabs(ball.dx) + 1.0f;
+}
+
+void aiDecide(AiController& ai, const Ball& ball, const Paddle& paddle, bool leftSide, bool& up, bool& down) {
+    int capacity = ai.reactionTicks + 1;
+
+    // A serve starts a new point: forget the old ball and draw a new aim error, even when the
+    // ball comes straight back to the side that just conceded and so never stopped approaching
+    if (ai.historyCount > 0 && ballWasServed(ai.history[(ai.historyIndex + capacity - 1) % capacity], ball)) {
+        ai.historyIndex = 0;
+        ai.historyCount = 0;
+        ai.approaching = false;
+    }
+
+    // Remember this tick's ball and look at the one from reactionTicks ago
+    ai.history[ai.historyIndex] = ball;
+    ai.historyIndex = (ai.historyIndex + 1) % capacity;
+    if (ai.historyCount < capacity) {
+        ++ai.historyCount;
+    }
+    const Ball& seen = ai.history[ai.historyCount < capacity ? 0 : ai.historyIndex];
+
+    bool approaching = leftSide ? seen.dx < 0 : seen.dx > 0;
+    if (approaching && !ai.approaching) {
+        ai.aimOffset = aiRandom(ai) * ai.noise;
+    }
+    ai.approaching = approaching;
+
+    float faceX = leftSide ? static_cast<float>(paddle.x + paddle.w) : static_cast<float>(paddle.x - 2 * seen.r);
+    float target = predictInterceptY(seen, faceX, leftSide) + ai.aimOffset;
+    float center = paddle.y + paddle.h / 2.0f;
+
+    up = center > target + AI_DEAD_ZONE;
+    down = center < target - AI_DEAD_ZONE;
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include "game.h"
+
+// Longest reaction delay the controller can be configured with, in ticks
+const int AI_MAX_REACTION_TICKS = 63;
+
+// Computer player for one paddle. Difficulty comes from how stale its view of the ball is
+// (reactionTicks) and how far off it aims (noise, in pixels either side of the intercept).
+struct AiController {
+    bool enabled;
+    int reactionTicks;
+    float noise;
+    unsigned rngState;
+
+    // Ring of past ball observations, the controller only ever sees the oldest one
+    Ball history[AI_MAX_REACTION_TICKS + 1];
+    int historyIndex;
+    int historyCount;
+
+    // Aim error is drawn once per approach and per serve, not per tick, so the paddle doesn't jitter
+    float aimOffset;
+    bool approaching;
+};
+
+// Function to set up a controller (seed makes the aim noise reproducible)
+void initAi(AiController& ai, int reactionTicks, float noise, unsigned seed);
+
+// Function to predict the ball's centre y when it next reaches faceX, folding wall bounces in closed form
+float predictInterceptY(const Ball& ball, float faceX, bool leftSide);
+
+// Function to choose this tick's paddle controls; O(1) per call
+void aiDecide(AiController& ai, const Ball& ball, const Paddle& paddle, bool leftSide, bool& up, bool& down);
@@ -0,0 +1,125 @@
+#include "allocguard.h"
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+// Counters only move while the check is armed; the hooks stay installed for the whole run
+static std::atomic<bool> armed(false);
+static std::atomic<Uint64> newCount(0);
+static std::atomic<Uint64> allocatedBytes(0);
+static std::atomic<Uint64> sdlCount(0);
+static std::atomic<size_t> firstSize(0);
+
+static bool checkEnabled = false;
+static int checkFrames = 0;
+static int frameIndex = 0;
+
+static SDL_malloc_func realMalloc = nullptr;
+static SDL_calloc_func realCalloc = nullptr;
+static SDL_realloc_func realRealloc = nullptr;
+static SDL_free_func realFree = nullptr;
+
+// Function to count one allocation of the given size
+static void countAllocation(std::atomic<Uint64>& counter, size_t size) {
+    if (armed.load(std::memory_order_relaxed)) {
+        if (counter.fetch_add(1) == 0 && firstSize.load() == 0) {
+            firstSize = size;
+        }
+        allocatedBytes += size;
+    }
+}
+
+// SDL memory functions that count, then forward to the ones SDL was using
+static void* SDLCALL countingMalloc(size_t size) {
+    countAllocation(sdlCount, size);
+    return realMalloc(size);
+}
+
+static void* SDLCALL countingCalloc(size_t count, size_t size) {
+    countAllocation(sdlCount, count * size);
+    return realCalloc(count, size);
+}
+
+static void* SDLCALL countingRealloc(void* memory, size_t size) {
+    countAllocation(sdlCount, size);
+    return realRealloc(memory, size);
+}
+
+static void SDLCALL countingFree(void* memory) {
+    realFree(memory);
+}
+
+void installAllocationHooks() {
+    SDL_GetMemoryFunctions(&realMalloc, &realCalloc, &realRealloc, &realFree);
+    SDL_SetMemoryFunctions(countingMalloc, countingCalloc, countingRealloc, countingFree);
+}
+
+void startAllocationCheck(int frames) {
+    checkEnabled = true;
+    checkFrames = frames;
+    frameIndex = 0;
+}
+
+bool allocationCheckActive() {
+    return checkEnabled;
+}
+
+bool allocationCheckFrame() {
+    ++frameIndex;
+    if (frameIndex == ALLOCATION_CHECK_WARMUP_FRAMES) {
+        armed = true;
+    }
+    if (frameIndex >= ALLOCATION_CHECK_WARMUP_FRAMES + checkFrames) {
+        armed = false;
+        return false;
+    }
+    return true;
+}
+
+bool reportAllocationCheck() {
+    if (!checkEnabled) {
+        return true;
+    }
+    armed = false;
+    int counted = frameIndex - ALLOCATION_CHECK_WARMUP_FRAMES;
+    Uint64 total = newCount + sdlCount;
+    std::cout << "Allocation check: " << (counted > 0 ? counted : 0) << " frames after " << ALLOCATION_CHECK_WARMUP_FRAMES
+        << " warm-up frames, " << newCount << " operator new and " << sdlCount << " SDL allocations (" << allocatedBytes << " bytes)";
+    if (total > 0) {
+        std::cout << ", first was " << firstSize << " bytes";
+    }
+    std::cout << std::endl;
+    std::cout << (total == 0 ? "PASS: steady-state frames do not allocate" : "FAIL: steady-state frames allocate") << std::endl;
+    return total == 0;
+}
+
+// Global operator new/delete, counted while armed
+void* operator new(size_t size) {
+    countAllocation(newCount, size);
+    void* memory = std::malloc(size != 0 ? size : 1);
+    if (memory == nullptr) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept {
+    std::free(memory);
+}
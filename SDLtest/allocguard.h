@@ -0,0 +1,20 @@
+#pragma once
+#include <SDL.h>
+
+// Frames played before counting starts, so caches and batch buffers reach their working size
+const int ALLOCATION_CHECK_WARMUP_FRAMES = 300;
+
+// Function to route SDL's allocations through the counters too; must run before SDL_Init
+void installAllocationHooks();
+
+// Function to enable the check: play headless, then count every allocation over this many frames
+void startAllocationCheck(int frames);
+
+// Function to check whether the game is running as an allocation check
+bool allocationCheckActive();
+
+// Function to drive the check once per main loop iteration, returns false when all frames are counted
+bool allocationCheckFrame();
+
+// Function to print what was counted, returns true if no frame allocated
+bool reportAllocationCheck();
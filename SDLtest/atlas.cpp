@@ -0,0 +1,262 @@
+#include "atlas.h"
+#include "perfhud.h"
+#include <iostream>
+
+// Padding between packed images so linear filtering never bleeds into a neighbour
+static const int ATLAS_PADDING = 1;
+static const char FIRST_GLYPH = 32;
+static const char LAST_GLYPH = 126;
+
+// One page of the atlas: CPU-side surface while building, texture afterwards
+struct AtlasPage {
+    SkylinePacker packer;
+    SDL_Surface* surface;
+    SDL_Texture* texture;
+};
+
+// Baked glyphs of one font
+struct AtlasFontData {
+    bool loaded;
+    int height;
+    AtlasSprite glyphs[LAST_GLYPH - FIRST_GLYPH + 1];
+    int advances[LAST_GLYPH - FIRST_GLYPH + 1];
+};
+
+static AtlasPage pages[ATLAS_MAX_PAGES];
+static int pageCount = 0;
+static AtlasFontData fonts[static_cast<int>(AtlasFont::COUNT)];
+static AtlasSprite whiteSprite;
+
+void initPacker(SkylinePacker& packer, int width, int height) {
+    packer.width = width;
+    packer.height = height;
+    packer.skyline.clear();
+    packer.skyline.push_back({ 0, 0, width });
+}
+
+// Function to get the lowest y a w-wide rectangle can sit at when its left edge is on skyline node i
+static int skylineFit(const SkylinePacker& packer, size_t i, int w, int h) {
+    int x = packer.skyline[i].x;
+    if (x + w > packer.width) {
+        return -1;
+    }
+    int y = 0;
+    int remaining = w;
+    while (remaining > 0) {
+        y = SDL_max(y, packer.skyline[i].y);
+        if (y + h > packer.height) {
+            return -1;
+        }
+        remaining -= packer.skyline[i].w;
+        ++i;
+    }
+    return y;
+}
+
+bool packRect(SkylinePacker& packer, int w, int h, SDL_Rect& out) {
+    int bestY = packer.height;
+    int bestWidth = packer.width + 1;
+    int bestIndex = -1;
+
+    // Bottom-left rule: lowest resulting top edge, narrowest segment on ties
+    for (size_t i = 0; i < packer.skyline.size(); ++i) {
+        int y = skylineFit(packer, i, w, h);
+        if (y < 0) {
+            continue;
+        }
+        if (y + h < bestY || (y + h == bestY && packer.skyline[i].w < bestWidth)) {
+            bestY = y + h;
+            bestWidth = packer.skyline[i].w;
+            bestIndex = static_cast<int>(i);
+            out = { packer.skyline[i].x, y, w, h };
+        }
+    }
+    if (bestIndex < 0) {
+        return false;
+    }
+
+    // Raise the skyline over the new rectangle and trim the nodes it covers
+    SkylineNode node = { out.x, out.y + h, w };
+    packer.skyline.insert(packer.skyline.begin() + bestIndex, node);
+    for (size_t i = bestIndex + 1; i < packer.skyline.size(); ) {
+        SkylineNode& previous = packer.skyline[i - 1];
+        SkylineNode& current = packer.skyline[i];
+        if (current.x >= previous.x + previous.w) {
+            break;
+        }
+        int shrink = previous.x + previous.w - current.x;
+        current.x += shrink;
+        current.w -= shrink;
+        if (current.w > 0) {
+            break;
+        }
+        packer.skyline.erase(packer.skyline.begin() + i);
+    }
+
+    // Merge neighbours at the same height
+    for (size_t i = 0; i + 1 < packer.skyline.size(); ) {
+        if (packer.skyline[i].y == packer.skyline[i + 1].y) {
+            packer.skyline[i].w += packer.skyline[i + 1].w;
+            packer.skyline.erase(packer.skyline.begin() + i + 1);
+        }
+        else {
+            ++i;
+        }
+    }
+    return true;
+}
+
+// Function to append a new blank page
+static bool addPage() {
+    if (pageCount == ATLAS_MAX_PAGES) {
+        std::cerr << "Texture atlas is full!" << std::endl;
+        return false;
+    }
+    AtlasPage& page = pages[pageCount];
+    page.surface = SDL_CreateRGBSurfaceWithFormat(0, ATLAS_PAGE_SIZE, ATLAS_PAGE_SIZE, 32, SDL_PIXELFORMAT_RGBA32);
+    if (page.surface == nullptr) {
+        std::cerr << "Unable to create atlas surface! SDL Error: " << SDL_GetError() << std::endl;
+        return false;
+    }
+    SDL_FillRect(page.surface, NULL, 0);
+    page.texture = nullptr;
+    initPacker(page.packer, ATLAS_PAGE_SIZE, ATLAS_PAGE_SIZE);
+    ++pageCount;
+    return true;
+}
+
+void createAtlas() {
+    destroyAtlas();
+    addPage();
+
+    // A small white block for solid-colour quads drawn through the same batch
+    SDL_Surface* white = SDL_CreateRGBSurfaceWithFormat(0, 4, 4, 32, SDL_PIXELFORMAT_RGBA32);
+    SDL_FillRect(white, NULL, 0xFFFFFFFF);
+    atlasAddSurface(white, whiteSprite);
+    SDL_FreeSurface(white);
+    // Sample only the inner texels so filtering never reaches the transparent border
+    whiteSprite.rect = { whiteSprite.rect.x + 1, whiteSprite.rect.y + 1, 2, 2 };
+}
+
+bool atlasAddSurface(SDL_Surface* surface, AtlasSprite& out) {
+    if (surface == nullptr || pageCount == 0) {
+        return false;
+    }
+    int w = surface->w + ATLAS_PADDING;
+    int h = surface->h + ATLAS_PADDING;
+
+    // Try existing pages first, then open a new one
+    SDL_Rect slot;
+    int page = 0;
+    while (!packRect(pages[page].packer, w, h, slot)) {
+        if (++page == pageCount && !addPage()) {
+            return false;
+        }
+    }
+
+    SDL_Rect dst = { slot.x, slot.y, surface->w, surface->h };
+    SDL_SetSurfaceBlendMode(surface, SDL_BLENDMODE_NONE);
+    SDL_BlitSurface(surface, NULL, pages[page].surface, &dst);
+    out.page = page;
+    out.rect = dst;
+    return true;
+}
+
+bool atlasAddFont(AtlasFont font, const char* file, int size, int style) {
+    TTF_Font* ttf = TTF_OpenFont(file, size);
+    if (ttf == nullptr) {
+        std::cerr << "Failed to load font! SDL_ttf Error: " << TTF_GetError() << std::endl;
+        return false;
+    }
+    TTF_SetFontStyle(ttf, style);
+
+    // Glyphs are baked white so batchText() can tint them with the vertex colour
+    AtlasFontData& data = fonts[static_cast<int>(font)];
+    SDL_Color white = { 255, 255, 255, 255 };
+    data.height = TTF_FontHeight(ttf);
+    for (char c = FIRST_GLYPH; c <= LAST_GLYPH; ++c) {
+        int index = c - FIRST_GLYPH;
+        int advance = 0;
+        TTF_GlyphMetrics(ttf, static_cast<Uint16>(c), NULL, NULL, NULL, NULL, &advance);
+        data.advances[index] = advance;
+        data.glyphs[index] = { -1, { 0, 0, 0, 0 } };
+
+        SDL_Surface* glyph = TTF_RenderGlyph_Blended(ttf, static_cast<Uint16>(c), white);
+        if (glyph == nullptr) {
+            continue; // e.g. the space character has nothing to draw
+        }
+        bool added = atlasAddSurface(glyph, data.glyphs[index]);
+        SDL_FreeSurface(glyph);
+        if (!added) {
+            TTF_CloseFont(ttf);
+            return false;
+        }
+    }
+    data.loaded = true;
+    TTF_CloseFont(ttf);
+    return true;
+}
+
+bool finalizeAtlas(SDL_Renderer* renderer) {
+    for (int i = 0; i < pageCount; ++i) {
+        pages[i].texture = SDL_CreateTextureFromSurface(renderer, pages[i].surface);
+        if (pages[i].texture == nullptr) {
+            std::cerr << "Unable to create atlas texture! SDL Error: " << SDL_GetError() << std::endl;
+            return false;
+        }
+        SDL_SetTextureBlendMode(pages[i].texture, SDL_BLENDMODE_BLEND);
+        hudCount(HudCounter::TEXTURES);
+        // The surface stays for the offline rasterizer
+    }
+    return true;
+}
+
+void destroyAtlas() {
+    for (int i = 0; i < pageCount; ++i) {
+        SDL_FreeSurface(pages[i].surface);
+        SDL_DestroyTexture(pages[i].texture);
+        pages[i].surface = nullptr;
+        pages[i].texture = nullptr;
+    }
+    pageCount = 0;
+    for (AtlasFontData& data : fonts) {
+        data.loaded = false;
+    }
+}
+
+SDL_Texture* atlasPageTexture(int page) {
+    return (page >= 0 && page < pageCount) ? pages[page].texture : nullptr;
+}
+
+const SDL_Surface* atlasPageSurface(int page) {
+    return (page >= 0 && page < pageCount) ? pages[page].surface : nullptr;
+}
+
+const AtlasSprite& atlasWhiteSprite() {
+    return whiteSprite;
+}
+
+const AtlasSprite* atlasGlyph(AtlasFont font, char c, int* advance) {
+    const AtlasFontData& data = fonts[static_cast<int>(font)];
+    if (!data.loaded || c < FIRST_GLYPH || c > LAST_GLYPH) {
+        *advance = 0;
+        return nullptr;
+    }
+    int index = c - FIRST_GLYPH;
+    *advance = data.advances[index];
+    return data.glyphs[index].page >= 0 ? &data.glyphs[index] : nullptr;
+}
+
+int atlasTextWidth(AtlasFont font, const char* text) {
+    int width = 0;
+    for (const char* c = text; *c != '\0'; ++c) {
+        int advance = 0;
+        atlasGlyph(font, *c, &advance);
+        width += advance;
+    }
+    return width;
+}
+
+int atlasTextHeight(AtlasFont font) {
+    return fonts[static_cast<int>(font)].height;
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <SDL.h>
+#include <SDL_ttf.h>
+#include <vector>
+
+// Size of one atlas page texture
+const int ATLAS_PAGE_SIZE = 1024;
+// Upper bound on pages, normally everything fits in the first one
+const int ATLAS_MAX_PAGES = 4;
+
+// Fonts baked into the atlas, one entry per font/size combination the game draws with
+enum class AtlasFont { MENU, SCORE, HUD, COUNT };
+
+// A packed image: which page it lives on and where
+struct AtlasSprite {
+    int page;
+    SDL_Rect rect;
+};
+
+// Skyline bottom-left rectangle packer for a single page
+struct SkylineNode {
+    int x, y, w;
+};
+
+struct SkylinePacker {
+    int width, height;
+    std::vector<SkylineNode> skyline;
+};
+
+// Function to reset a packer to an empty page of the given size
+void initPacker(SkylinePacker& packer, int width, int height);
+
+// Function to find room for a w x h rectangle, returns false when the page is full
+bool packRect(SkylinePacker& packer, int w, int h, SDL_Rect& out);
+
+// Function to start building the atlas (call once before adding anything)
+void createAtlas();
+
+// Function to copy a surface into the atlas and return where it was placed
+bool atlasAddSurface(SDL_Surface* surface, AtlasSprite& out);
+
+// Function to bake the printable ASCII glyphs of a font into the atlas
+bool atlasAddFont(AtlasFont font, const char* file, int size, int style);
+
+// Function to upload the atlas pages as textures once everything has been added
+bool finalizeAtlas(SDL_Renderer* renderer);
+
+// Function to free the atlas surfaces and textures
+void destroyAtlas();
+
+// Function to get the texture of an atlas page
+SDL_Texture* atlasPageTexture(int page);
+
+// Function to get the pixels of an atlas page (RGBA32), kept after upload for the offline rasterizer
+const SDL_Surface* atlasPageSurface(int page);
+
+// Function to get the white texel sprite used for solid-colour quads
+const AtlasSprite& atlasWhiteSprite();
+
+// Function to look up a baked glyph, returns nullptr for characters not in the atlas
+const AtlasSprite* atlasGlyph(AtlasFont font, char c, int* advance);
+
+// Function to measure a string the way batchText() will lay it out
+int atlasTextWidth(AtlasFont font, const char* text);
+int atlasTextHeight(AtlasFont font);
@@ -0,0 +1,250 @@
+#include "audio.h"
+#include "trace.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iostream>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MIXER_X86 1
+#endif
+
+// GCC/Clang need the instruction set enabled per function, MSVC accepts the intrinsics anywhere
+#if defined(MIXER_X86) && (defined(__GNUC__) || defined(__clang__))
+#define MIXER_TARGET(isa) __attribute__((target(isa)))
+#else
+#define MIXER_TARGET(isa)
+#endif
+
+// A pre-decoded chunk playing on one of the mixer voices
+struct Voice {
+    const Sint16* samples;
+    Uint32 length;   // in samples (both channels interleaved)
+    Uint32 position;
+    bool active;
+};
+
+// A play request handed from the game thread to the audio callback
+struct Trigger {
+    const Sint16* samples;
+    Uint32 length;
+    Uint64 triggeredAt;
+};
+
+static const int TRIGGER_QUEUE_SIZE = 64; // power of two
+static const int LATENCY_HISTORY = 4096;
+
+typedef void (*MixFunction)(Sint16* dst, const Sint16* src, int count);
+
+static SDL_AudioDeviceID mixerDevice = 0;
+static int mixerFrequency = 44100;
+static int mixerFrames = 0;
+static MixFunction mixSamples = nullptr;
+static const char* mixPathName = "scalar";
+static Voice voices[MIXER_VOICES];
+
+// Single-producer/single-consumer queue: update() pushes, the audio callback pops
+static Trigger triggerQueue[TRIGGER_QUEUE_SIZE];
+static std::atomic<unsigned> triggerHead(0);
+static std::atomic<unsigned> triggerTail(0);
+
+// Event-to-output latency samples in microseconds, only touched by the audio callback
+static Uint32 latencyHistory[LATENCY_HISTORY];
+static int latencyCount = 0;
+static int droppedTriggers = 0;
+
+// Function to add src into dst with 16-bit saturation, one sample at a time
+static void mixScalar(Sint16* dst, const Sint16* src, int count) {
+    for (int i = 0; i < count; ++i) {
+        int sample = dst[i] + src[i];
+        dst[i] = static_cast<Sint16>(std::min(32767, std::max(-32768, sample)));
+    }
+}
+
+#ifdef MIXER_X86
+// Function to add src into dst with 16-bit saturation, 8 samples per SSE2 instruction
+MIXER_TARGET("sse2")
+static void mixSSE2(Sint16* dst, const Sint16* src, int count) {
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_adds_epi16(a, b));
+    }
+    mixScalar(dst + i, src + i, count - i);
+}
+
+// Function to add src into dst with 16-bit saturation, 16 samples per AVX2 instruction
+MIXER_TARGET("avx2")
+static void mixAVX2(Sint16* dst, const Sint16* src, int count) {
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_adds_epi16(a, b));
+    }
+    mixScalar(dst + i, src + i, count - i);
+}
+#endif
+
+// Function to move queued play requests onto free voices and record their latency
+static void startTriggeredVoices(Uint64 now) {
+    unsigned tail = triggerTail.load(std::memory_order_relaxed);
+    unsigned head = triggerHead.load(std::memory_order_acquire);
+    Uint64 frequency = SDL_GetPerformanceFrequency();
+    // The buffer being filled now is heard after the one currently playing
+    Uint64 bufferMicros = static_cast<Uint64>(mixerFrames) * 1000000 / mixerFrequency;
+
+    while (tail != head) {
+        const Trigger& trigger = triggerQueue[tail & (TRIGGER_QUEUE_SIZE - 1)];
+        Voice* freeVoice = nullptr;
+        for (Voice& voice : voices) {
+            if (!voice.active) {
+                freeVoice = &voice;
+                break;
+            }
+        }
+        if (freeVoice != nullptr) {
+            freeVoice->samples = trigger.samples;
+            freeVoice->length = trigger.length;
+            freeVoice->position = 0;
+            freeVoice->active = true;
+            if (latencyCount < LATENCY_HISTORY) {
+                Uint64 waitedMicros = (now - trigger.triggeredAt) * 1000000 / frequency;
+                latencyHistory[latencyCount++] = static_cast<Uint32>(waitedMicros + bufferMicros);
+            }
+        }
+        else {
+            ++droppedTriggers; // Mix_PlayChannel(-1, ...) fails the same way when every channel is busy
+        }
+        ++tail;
+    }
+    triggerTail.store(tail, std::memory_order_release);
+}
+
+// Function called by SDL on the audio thread to fill the next output buffer
+static void SDLCALL mixerCallback(void* userdata, Uint8* stream, int len) {
+    (void)userdata;
+    traceThreadName("audio");
+    TRACE_SCOPE("mix");
+    startTriggeredVoices(SDL_GetPerformanceCounter());
+
+    std::memset(stream, 0, len);
+    Sint16* out = reinterpret_cast<Sint16*>(stream);
+    int count = len / static_cast<int>(sizeof(Sint16));
+
+    for (Voice& voice : voices) {
+        if (!voice.active) {
+            continue;
+        }
+        int remaining = static_cast<int>(voice.length - voice.position);
+        int n = std::min(count, remaining);
+        mixSamples(out, voice.samples + voice.position, n);
+        voice.position += n;
+        if (voice.position >= voice.length) {
+            voice.active = false;
+        }
+    }
+}
+
+bool openLowLatencyMixer(int bufferFrames) {
+    int frequency = 0;
+    Uint16 format = 0;
+    int channels = 0;
+    if (Mix_QuerySpec(&frequency, &format, &channels) == 0) {
+        std::cerr << "Low-latency mixer needs SDL_mixer opened first to decode the effects!" << std::endl;
+        return false;
+    }
+    if (format != AUDIO_S16SYS || channels != 2) {
+        std::cerr << "Low-latency mixer only supports 16-bit stereo chunks!" << std::endl;
+        return false;
+    }
+
+    // Chunks stay decoded in memory, only the SDL_mixer playback device is released
+    Mix_CloseAudio();
+    if (SDL_InitSubSystem(SDL_INIT_AUDIO) < 0) {
+        std::cerr << "SDL audio could not initialize! SDL_Error: " << SDL_GetError() << std::endl;
+        return false;
+    }
+
+    mixerFrames = std::max(MIXER_MIN_FRAMES, std::min(MIXER_MAX_FRAMES, bufferFrames));
+    mixerFrequency = frequency;
+
+    SDL_AudioSpec desired;
+    SDL_memset(&desired, 0, sizeof(desired));
+    desired.freq = frequency;
+    desired.format = AUDIO_S16SYS;
+    desired.channels = 2;
+    desired.samples = static_cast<Uint16>(mixerFrames);
+    desired.callback = mixerCallback;
+
+    // No allowed changes: SDL converts if the hardware differs, so the callback always sees our format
+    SDL_AudioSpec obtained;
+    mixerDevice = SDL_OpenAudioDevice(NULL, 0, &desired, &obtained, 0);
+    if (mixerDevice == 0) {
+        std::cerr << "Audio device could not be opened! SDL_Error: " << SDL_GetError() << std::endl;
+        return false;
+    }
+
+    mixSamples = mixScalar;
+    mixPathName = "scalar";
+#ifdef MIXER_X86
+    if (SDL_HasAVX2()) {
+        mixSamples = mixAVX2;
+        mixPathName = "AVX2";
+    }
+    else if (SDL_HasSSE2()) {
+        mixSamples = mixSSE2;
+        mixPathName = "SSE2";
+    }
+#endif
+
+    SDL_PauseAudioDevice(mixerDevice, 0);
+    std::cout << "Low-latency mixer: " << mixerFrames << " frames @ " << mixerFrequency << " Hz, " << mixPathName << " mixing" << std::endl;
+    return true;
+}
+
+void mixerPlay(const Mix_Chunk* chunk) {
+    if (chunk == nullptr || mixerDevice == 0) {
+        return;
+    }
+    unsigned head = triggerHead.load(std::memory_order_relaxed);
+    unsigned tail = triggerTail.load(std::memory_order_acquire);
+    if (head - tail >= static_cast<unsigned>(TRIGGER_QUEUE_SIZE)) {
+        return; // Callback stalled, drop rather than block the game loop
+    }
+    Trigger& trigger = triggerQueue[head & (TRIGGER_QUEUE_SIZE - 1)];
+    trigger.samples = reinterpret_cast<const Sint16*>(chunk->abuf);
+    trigger.length = chunk->alen / sizeof(Sint16);
+    trigger.triggeredAt = SDL_GetPerformanceCounter();
+    triggerHead.store(head + 1, std::memory_order_release);
+}
+
+void closeLowLatencyMixer() {
+    if (mixerDevice == 0) {
+        return;
+    }
+    SDL_CloseAudioDevice(mixerDevice);
+    mixerDevice = 0;
+
+    if (latencyCount == 0) {
+        std::cout << "Low-latency mixer: no sounds played" << std::endl;
+        return;
+    }
+    std::sort(latencyHistory, latencyHistory + latencyCount);
+    Uint64 total = 0;
+    for (int i = 0; i < latencyCount; ++i) {
+        total += latencyHistory[i];
+    }
+    std::cout << "Low-latency mixer event-to-output latency over " << latencyCount << " sounds (ms): "
+        << "min " << latencyHistory[0] / 1000.0
+        << ", avg " << total / latencyCount / 1000.0
+        << ", p95 " << latencyHistory[latencyCount * 95 / 100] / 1000.0
+        << ", max " << latencyHistory[latencyCount - 1] / 1000.0
+        << ", dropped " << droppedTriggers << std::endl;
+}
+
+bool lowLatencyMixerActive() {
+    return mixerDevice != 0;
+}
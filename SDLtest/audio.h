@@ -0,0 +1,23 @@
+#pragma once
+#include <SDL.h>
+#include <SDL_mixer.h>
+
+// Buffer size limits (in sample frames) for the low-latency mixer
+const int MIXER_MIN_FRAMES = 128;
+const int MIXER_MAX_FRAMES = 512;
+// Same number of voices SDL_mixer allocates by default, so overlapping effects drop identically
+const int MIXER_VOICES = 8;
+
+// Function to switch playback from SDL_mixer to the in-house mixer on the raw SDL audio callback.
+// Must be called after the chunks have been loaded through Mix_OpenAudio so they are already
+// decoded to 16-bit stereo PCM at the mixer frequency.
+bool openLowLatencyMixer(int bufferFrames);
+
+// Function to start a chunk on the first free voice (same semantics as Mix_PlayChannel(-1, chunk, 0))
+void mixerPlay(const Mix_Chunk* chunk);
+
+// Function to stop the mixer and print the event-to-output latency it measured
+void closeLowLatencyMixer();
+
+// Function to check whether the low-latency mixer is currently driving the audio device
+bool lowLatencyMixerActive();
@@ -0,0 +1,264 @@
+#include "capture.h"
+#include "trace.h"
+#include <SDL_image.h>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A readback buffer and the frame number it holds
+struct CaptureSlot {
+    std::vector<Uint32> pixels;     // ARGB8888
+    Uint32 frame;
+};
+
+static bool active = false;
+static bool y4m = false;
+static char pathPattern[512];
+static FILE* video = nullptr;
+static int width = 0;
+static int height = 0;
+static int captureFps = 0;
+static Uint32 startMs = 0;
+static Uint32 nextFrame = 0;        // first frame period not captured yet
+
+// Slots move free -> filled by the game thread -> written by the writer thread -> free again.
+// Both lists are FIFO queues of slot indices guarded by queueMutex.
+static CaptureSlot slots[CAPTURE_BUFFERS];
+static int freeSlots[CAPTURE_BUFFERS];
+static int freeCount = 0;
+static int readySlots[CAPTURE_BUFFERS];
+static int readyHead = 0;
+static int readyCount = 0;
+static std::mutex queueMutex;
+static std::condition_variable frameReady;
+static bool stopping = false;
+static std::thread writer;
+
+// Counters for the report
+static Uint32 framesCaptured = 0;
+static Uint32 framesWritten = 0;
+static Uint32 framesDropped = 0;
+static Uint32 writeErrors = 0;
+static int maxQueueDepth = 0;
+static Uint64 readbackCounter = 0;
+
+// Y4M planes and the next frame number the video expects, only touched by the writer thread
+static std::vector<Uint8> planes;
+static Uint32 nextVideoFrame = 0;
+
+// Function to append the planes as one Y4M frame
+static bool writePlanes() {
+    return std::fputs("FRAME\n", video) >= 0 && std::fwrite(planes.data(), 1, planes.size(), video) == planes.size();
+}
+
+// Function to convert ARGB to BT.601 studio-range 4:2:0 and append it as one Y4M frame
+static bool writeY4mFrame(const std::vector<Uint32>& pixels) {
+    Uint8* lumaPlane = planes.data();
+    Uint8* uPlane = lumaPlane + width * height;
+    Uint8* vPlane = uPlane + (width / 2) * (height / 2);
+    for (int y = 0; y < height; ++y) {
+        const Uint32* row = pixels.data() + static_cast<size_t>(y) * width;
+        Uint8* luma = lumaPlane + static_cast<size_t>(y) * width;
+        for (int x = 0; x < width; ++x) {
+            int r = (row[x] >> 16) & 0xFF, g = (row[x] >> 8) & 0xFF, b = row[x] & 0xFF;
+            luma[x] = static_cast<Uint8>(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+        }
+    }
+    // Chroma from the average of each 2x2 block
+    for (int y = 0; y < height / 2; ++y) {
+        const Uint32* top = pixels.data() + static_cast<size_t>(2 * y) * width;
+        const Uint32* bottom = top + width;
+        for (int x = 0; x < width / 2; ++x) {
+            int r = 0, g = 0, b = 0;
+            const Uint32 block[4] = { top[2 * x], top[2 * x + 1], bottom[2 * x], bottom[2 * x + 1] };
+            for (Uint32 pixel : block) {
+                r += (pixel >> 16) & 0xFF;
+                g += (pixel >> 8) & 0xFF;
+                b += pixel & 0xFF;
+            }
+            r = (r + 2) >> 2;
+            g = (g + 2) >> 2;
+            b = (b + 2) >> 2;
+            uPlane[y * (width / 2) + x] = static_cast<Uint8>(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+            vPlane[y * (width / 2) + x] = static_cast<Uint8>(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+        }
+    }
+    return writePlanes();
+}
+
+static bool writePngFrame(const CaptureSlot& slot) {
+    char path[600];
+    std::snprintf(path, sizeof(path), pathPattern, static_cast<unsigned>(slot.frame));
+    SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormatFrom(const_cast<Uint32*>(slot.pixels.data()), width, height, 32, width * 4,
+        SDL_PIXELFORMAT_ARGB8888);
+    if (surface == nullptr) {
+        return false;
+    }
+    bool saved = IMG_SavePNG(surface, path) == 0;
+    SDL_FreeSurface(surface);
+    return saved;
+}
+
+// Function run by the writer thread: encode and write queued frames in order until told to stop with nothing queued
+static void writerLoop() {
+    traceThreadName("capture writer");
+    std::unique_lock<std::mutex> lock(queueMutex);
+    while (true) {
+        frameReady.wait(lock, [] { return stopping || readyCount > 0; });
+        if (readyCount == 0) {
+            return;
+        }
+        int index = readySlots[readyHead];
+        lock.unlock();
+
+        bool written;
+        {
+            TRACE_SCOPE("write frame");
+            if (y4m) {
+                // The video has a fixed frame rate: a dropped or skipped frame shows the one before it again
+                written = true;
+                for (; nextVideoFrame < slots[index].frame && nextVideoFrame > 0 && written; ++nextVideoFrame) {
+                    written = writePlanes();
+                }
+                written = written && writeY4mFrame(slots[index].pixels);
+                nextVideoFrame = slots[index].frame + 1;
+            }
+            else {
+                written = writePngFrame(slots[index]);
+            }
+        }
+
+        lock.lock();
+        readyHead = (readyHead + 1) % CAPTURE_BUFFERS;
+        --readyCount;
+        freeSlots[freeCount++] = index;
+        if (written) {
+            ++framesWritten;
+        }
+        else {
+            ++writeErrors;
+        }
+    }
+}
+
+bool startCapture(const char* path, SDL_Renderer* renderer, int fps) {
+    if (SDL_GetRendererOutputSize(renderer, &width, &height) != 0) {
+        std::cerr << "Unable to get the renderer size! SDL Error: " << SDL_GetError() << std::endl;
+        return false;
+    }
+    captureFps = fps > 0 ? fps : CAPTURE_DEFAULT_FPS;
+    size_t length = std::strlen(path);
+    y4m = length > 4 && std::strcmp(path + length - 4, ".y4m") == 0;
+    if (y4m) {
+        // 4:2:0 needs even dimensions; an odd last row or column is left out
+        width &= ~1;
+        height &= ~1;
+        video = std::fopen(path, "wb");
+        if (video == nullptr) {
+            std::cerr << "Unable to create " << path << std::endl;
+            return false;
+        }
+        std::fprintf(video, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", width, height, captureFps);
+        planes.resize(static_cast<size_t>(width) * height * 3 / 2);
+        nextVideoFrame = 0;
+    }
+    else {
+        std::strncpy(pathPattern, path, sizeof(pathPattern) - 1);
+        pathPattern[sizeof(pathPattern) - 1] = '\0';
+    }
+
+    for (int i = 0; i < CAPTURE_BUFFERS; ++i) {
+        slots[i].pixels.assign(static_cast<size_t>(width) * height, 0);
+        freeSlots[i] = i;
+    }
+    freeCount = CAPTURE_BUFFERS;
+    readyHead = 0;
+    readyCount = 0;
+    stopping = false;
+    startMs = SDL_GetTicks();
+    nextFrame = 0;
+    framesCaptured = 0;
+    framesWritten = 0;
+    framesDropped = 0;
+    writeErrors = 0;
+    maxQueueDepth = 0;
+    readbackCounter = 0;
+    writer = std::thread(writerLoop);
+    active = true;
+    return true;
+}
+
+void captureFrame(SDL_Renderer* renderer, Uint32 nowMs) {
+    if (!active) {
+        return;
+    }
+    // Frames are numbered by the period they fall in, counted exactly rather than in whole milliseconds,
+    // so frames the game never drew (a stall, a hidden or throttled window) leave a gap the writer fills
+    Uint32 frame = static_cast<Uint32>(static_cast<Uint64>(nowMs - startMs) * captureFps / 1000);
+    if (frame < nextFrame) {
+        return;
+    }
+    nextFrame = frame + 1;
+
+    int index = -1;
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        if (freeCount > 0) {
+            index = freeSlots[--freeCount];
+        }
+    }
+    if (index < 0) {
+        // The writer is behind with every buffer queued; never wait for it
+        ++framesDropped;
+        return;
+    }
+
+    // The only work left on this thread: one readback into a buffer allocated up front
+    Uint64 start = SDL_GetPerformanceCounter();
+    SDL_Rect area = { 0, 0, width, height };
+    bool read = SDL_RenderReadPixels(renderer, &area, SDL_PIXELFORMAT_ARGB8888, slots[index].pixels.data(), width * 4) == 0;
+    readbackCounter += SDL_GetPerformanceCounter() - start;
+
+    std::lock_guard<std::mutex> lock(queueMutex);
+    if (!read) {
+        freeSlots[freeCount++] = index;
+        ++writeErrors;
+        return;
+    }
+    slots[index].frame = frame;
+    readySlots[(readyHead + readyCount) % CAPTURE_BUFFERS] = index;
+    ++readyCount;
+    maxQueueDepth = readyCount > maxQueueDepth ? readyCount : maxQueueDepth;
+    ++framesCaptured;
+    frameReady.notify_one();
+}
+
+void stopCapture() {
+    if (!active) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        stopping = true;
+    }
+    frameReady.notify_one();
+    writer.join();
+    if (video != nullptr) {
+        std::fclose(video);
+        video = nullptr;
+    }
+    active = false;
+
+    double readbackMs = framesCaptured > 0 ? 1000.0 * readbackCounter / SDL_GetPerformanceFrequency() / framesCaptured : 0.0;
+    std::cout << "Capture: " << framesWritten << " frames written, " << framesDropped << " dropped, " << writeErrors
+        << " failed, queue depth up to " << maxQueueDepth << " of " << CAPTURE_BUFFERS << ", " << readbackMs
+        << " ms readback per frame" << std::endl;
+}
+
+bool captureActive() {
+    return active;
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include <SDL.h>
+
+// Readback buffers cycling between the game and the writer thread; with all of them queued, frames are dropped
+const int CAPTURE_BUFFERS = 3;
+const int CAPTURE_DEFAULT_FPS = 30;
+
+// Function to start recording the screen: a path ending in .y4m writes one raw YUV 4:2:0 video,
+// anything else is a printf pattern for numbered PNGs (e.g. "capture/frame%05d.png")
+bool startCapture(const char* path, SDL_Renderer* renderer, int fps);
+
+// Function to grab the frame just drawn if one is due; call it before SDL_RenderPresent()
+void captureFrame(SDL_Renderer* renderer, Uint32 nowMs);
+
+// Function to write out everything queued, stop the writer thread and report drops and queue depth
+void stopCapture();
+
+bool captureActive();
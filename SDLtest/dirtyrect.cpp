@@ -0,0 +1,155 @@
+#include "dirtyrect.h"
+#include "game.h"
+#include <iostream>
+
+static SDL_Surface* windowSurface = nullptr;
+static SDL_Surface* background = nullptr;  // the field without anything that moves, same format as the window
+static bool active = false;
+static bool backgroundCaptured = false;
+static bool repaintAll = true;
+
+// Areas drawn last frame and this frame; both are restored and presented
+static SDL_Rect previous[DIRTY_MAX_RECTS];
+static int previousCount = 0;
+static SDL_Rect current[DIRTY_MAX_RECTS];
+static int currentCount = 0;
+static bool currentOverflow = false;
+// Union of both lists with overlapping areas merged
+static SDL_Rect merged[2 * DIRTY_MAX_RECTS];
+static int mergedCount = 0;
+
+// Pixels presented against the whole window, for the summary at exit
+static Uint64 framesPresented = 0;
+static Uint64 pixelsPresented = 0;
+
+SDL_Renderer* createDirtyRectRenderer(SDL_Window* window) {
+    windowSurface = SDL_GetWindowSurface(window);
+    if (windowSurface == nullptr) {
+        std::cerr << "Window surface could not be created! SDL_Error: " << SDL_GetError() << std::endl;
+        return nullptr;
+    }
+    SDL_Renderer* renderer = SDL_CreateSoftwareRenderer(windowSurface);
+    if (renderer == nullptr) {
+        std::cerr << "Software renderer could not be created! SDL_Error: " << SDL_GetError() << std::endl;
+        return nullptr;
+    }
+    background = SDL_CreateRGBSurfaceWithFormat(0, windowSurface->w, windowSurface->h, windowSurface->format->BitsPerPixel, windowSurface->format->format);
+    if (background == nullptr) {
+        std::cerr << "Background surface could not be created! SDL_Error: " << SDL_GetError() << std::endl;
+        SDL_DestroyRenderer(renderer);
+        return nullptr;
+    }
+    // Plain row copies both ways
+    SDL_SetSurfaceBlendMode(background, SDL_BLENDMODE_NONE);
+    SDL_SetSurfaceBlendMode(windowSurface, SDL_BLENDMODE_NONE);
+    active = true;
+    backgroundCaptured = false;
+    repaintAll = true;
+    previousCount = 0;
+    currentCount = 0;
+    currentOverflow = false;
+    return renderer;
+}
+
+void destroyDirtyRects() {
+    if (!active) {
+        return;
+    }
+    if (framesPresented > 0) {
+        std::cout << "Dirty rectangles: " << framesPresented << " frames, "
+            << 100.0 * pixelsPresented / (framesPresented * static_cast<Uint64>(windowSurface->w * windowSurface->h))
+            << "% of the window presented per frame" << std::endl;
+    }
+    SDL_FreeSurface(background);
+    background = nullptr;
+    windowSurface = nullptr;   // owned by the window
+    active = false;
+}
+
+bool dirtyRectsActive() {
+    return active;
+}
+
+bool needsBackground() {
+    return active && !backgroundCaptured;
+}
+
+void captureBackground(SDL_Renderer* renderer) {
+    SDL_RenderFlush(renderer);
+    SDL_BlitSurface(windowSurface, NULL, background, NULL);
+    backgroundCaptured = true;
+}
+
+void markDirty(const SDL_Rect& bounds) {
+    SDL_Rect screen = { 0, 0, windowSurface->w, windowSurface->h };
+    SDL_Rect clipped;
+    if (!SDL_IntersectRect(&bounds, &screen, &clipped)) {
+        return;
+    }
+    if (currentCount == DIRTY_MAX_RECTS) {
+        currentOverflow = true;
+        return;
+    }
+    current[currentCount++] = clipped;
+}
+
+// Function to add an area to the merged list, folding it into any area it overlaps
+static void mergeRect(SDL_Rect rect) {
+    for (int i = 0; i < mergedCount; ++i) {
+        if (SDL_HasIntersection(&rect, &merged[i])) {
+            SDL_UnionRect(&rect, &merged[i], &rect);
+            merged[i] = merged[--mergedCount];
+            i = -1;     // the grown area may now overlap ones already checked
+        }
+    }
+    merged[mergedCount++] = rect;
+}
+
+void restoreDirtyRects(SDL_Renderer* renderer) {
+    mergedCount = 0;
+    if (repaintAll || currentOverflow) {
+        merged[mergedCount++] = { 0, 0, windowSurface->w, windowSurface->h };
+    }
+    else {
+        for (int i = 0; i < previousCount; ++i) {
+            mergeRect(previous[i]);
+        }
+        for (int i = 0; i < currentCount; ++i) {
+            mergeRect(current[i]);
+        }
+    }
+    // The renderer may still be holding draw calls for the surface
+    SDL_RenderFlush(renderer);
+    for (int i = 0; i < mergedCount; ++i) {
+        SDL_Rect destination = merged[i];
+        SDL_BlitSurface(background, &merged[i], windowSurface, &destination);
+    }
+}
+
+void presentDirtyRects(SDL_Renderer* renderer, SDL_Window* window) {
+    SDL_RenderFlush(renderer);
+    SDL_UpdateWindowSurfaceRects(window, merged, mergedCount);
+    for (int i = 0; i < mergedCount; ++i) {
+        pixelsPresented += static_cast<Uint64>(merged[i].w) * merged[i].h;
+    }
+    ++framesPresented;
+
+    // This frame's areas are what the next frame has to clean up
+    SDL_memcpy(previous, current, currentCount * sizeof(SDL_Rect));
+    previousCount = currentCount;
+    currentCount = 0;
+    repaintAll = currentOverflow;
+    currentOverflow = false;
+}
+
+void repaintWholeWindow() {
+    repaintAll = true;
+}
+
+void presentWholeWindow(SDL_Renderer* renderer, SDL_Window* window) {
+    SDL_RenderFlush(renderer);
+    SDL_UpdateWindowSurface(window);
+    repaintAll = true;
+    currentCount = 0;
+    currentOverflow = false;
+}
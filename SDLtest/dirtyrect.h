@@ -0,0 +1,30 @@
+#pragma once
+#include <SDL.h>
+
+// Most areas tracked per frame; past this the whole window is repainted
+const int DIRTY_MAX_RECTS = 32;
+
+// Function to create a software renderer that draws straight into the window surface, so frames can be
+// presented a few rectangles at a time. Returns nullptr on failure.
+SDL_Renderer* createDirtyRectRenderer(SDL_Window* window);
+void destroyDirtyRects();
+bool dirtyRectsActive();
+
+// Function to check whether the static field still has to be drawn and cached; if so, draw it and call captureBackground()
+bool needsBackground();
+void captureBackground(SDL_Renderer* renderer);
+
+// Function to add an area a moving element is about to draw into. The area from the last frame is repainted as well.
+void markDirty(const SDL_Rect& bounds);
+
+// Function to copy the cached field back over everything marked this frame or the last, before the moving elements are drawn
+void restoreDirtyRects(SDL_Renderer* renderer);
+
+// Function to show only the marked areas of the window
+void presentDirtyRects(SDL_Renderer* renderer, SDL_Window* window);
+
+// Function to have the next tracked frame repaint and present the whole window, after its contents were lost
+void repaintWholeWindow();
+
+// Function to show a frame drawn without tracking (the menu); the next tracked frame repaints the whole window
+void presentWholeWindow(SDL_Renderer* renderer, SDL_Window* window);
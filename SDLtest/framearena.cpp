@@ -0,0 +1,52 @@
+#include "framearena.h"
+#include <cstdarg>
+#include <cstdio>
+#include <iostream>
+
+// One static block: the arena itself never touches the heap
+alignas(64) static unsigned char arena[FRAME_ARENA_SIZE];
+static size_t used = 0;
+static size_t highWater = 0;
+static bool overflowReported = false;
+
+void resetFrameArena() {
+    used = 0;
+}
+
+void* frameAlloc(size_t size, size_t alignment) {
+    size_t start = (used + alignment - 1) & ~(alignment - 1);
+    if (start + size > FRAME_ARENA_SIZE) {
+        if (!overflowReported) {
+            std::cerr << "Frame arena is full (" << FRAME_ARENA_SIZE << " bytes)!" << std::endl;
+            overflowReported = true;
+        }
+        return nullptr;
+    }
+    used = start + size;
+    if (used > highWater) {
+        highWater = used;
+    }
+    return arena + start;
+}
+
+const char* frameFormat(const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    va_list sizing;
+    va_copy(sizing, args);
+    int length = vsnprintf(nullptr, 0, format, sizing);
+    va_end(sizing);
+
+    char* text = length < 0 ? nullptr : static_cast<char*>(frameAlloc(static_cast<size_t>(length) + 1, 1));
+    if (text == nullptr) {
+        va_end(args);
+        return "";
+    }
+    vsnprintf(text, static_cast<size_t>(length) + 1, format, args);
+    va_end(args);
+    return text;
+}
+
+size_t frameArenaHighWater() {
+    return highWater;
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include <SDL.h>
+#include <cstddef>
+
+// Bytes of scratch memory available to one frame
+const size_t FRAME_ARENA_SIZE = 64 * 1024;
+
+// Function to release everything allocated during the previous frame; call once at the top of the loop
+void resetFrameArena();
+
+// Function to get scratch memory that lives until the next resetFrameArena(), nullptr once the arena is full
+void* frameAlloc(size_t size, size_t alignment = alignof(std::max_align_t));
+
+// Function to printf into frame memory, returns "" if the arena is full
+const char* frameFormat(const char* format, ...);
+
+// Function to get the most the arena has held in one frame, for sizing FRAME_ARENA_SIZE
+size_t frameArenaHighWater();
@@ -0,0 +1,277 @@
+#include "game.h"
+#include "trace.h"
+#include <cstdlib>
+
+// All mutable game state; the left player serves first
+GameState gameState = { {}, {}, {}, 0, 0, true, MenuOption::START };
+
+// Variables for paddles, ball, goal areas, and scores
+Paddle& leftPaddle = gameState.leftPaddle;
+Paddle& rightPaddle = gameState.rightPaddle;
+Ball& ball = gameState.ball;
+SDL_Rect leftGoal = { 0, (SCREEN_HEIGHT - ClassicConfig::goalHeight) / 2, ClassicConfig::goalDepth, ClassicConfig::goalHeight };
+SDL_Rect rightGoal = { SCREEN_WIDTH - ClassicConfig::goalDepth, (SCREEN_HEIGHT - ClassicConfig::goalHeight) / 2, ClassicConfig::goalDepth, ClassicConfig::goalHeight };
+int& leftScore = gameState.leftScore;
+int& rightScore = gameState.rightScore;
+
+void silentGameSound(GameSound sound) {
+    (void)sound;
+}
+
+// Sound hook, called with each collision so the simulation doesn't depend on the mixer
+void (*gameSoundHandler)(GameSound sound) = silentGameSound;
+// How long resetBall() holds the game before the serve
+Uint32 servePauseMs = 1000;
+
+// Runtime variant values, classic until --tune changes them
+int RuntimeConfig::paddleWidth = ClassicConfig::paddleWidth;
+int RuntimeConfig::paddleHeight = ClassicConfig::paddleHeight;
+int RuntimeConfig::paddleInset = ClassicConfig::paddleInset;
+int RuntimeConfig::paddleStep = ClassicConfig::paddleStep;
+int RuntimeConfig::ballRadius = ClassicConfig::ballRadius;
+int RuntimeConfig::ballSpeedX = ClassicConfig::ballSpeedX;
+int RuntimeConfig::ballSpeedY = ClassicConfig::ballSpeedY;
+int RuntimeConfig::goalHeight = ClassicConfig::goalHeight;
+int RuntimeConfig::goalDepth = ClassicConfig::goalDepth;
+int RuntimeConfig::circleRadius = ClassicConfig::circleRadius;
+
+GameTuning tuning = tuningOf<ClassicConfig>();
+
+// Function to put both paddles back at their starting positions
+template <typename Config>
+static void resetPaddlesKernel() {
+    leftPaddle = { Config::paddleInset, SCREEN_HEIGHT / 2 - Config::paddleHeight / 2, Config::paddleWidth, Config::paddleHeight };
+    rightPaddle = { SCREEN_WIDTH - Config::paddleInset - Config::paddleWidth, SCREEN_HEIGHT / 2 - Config::paddleHeight / 2, Config::paddleWidth, Config::paddleHeight };
+}
+
+// Function to reset the ball to its initial state
+template <typename Config>
+static void resetBallKernel(bool leftPlayerServe) {
+    ball.r = Config::ballRadius;
+    ball.angle = 0;
+
+    // Position the ball at the middle of the screen
+    ball.x = SCREEN_WIDTH / 2 - ball.r;
+    ball.y = SCREEN_HEIGHT / 2;
+
+    // Calculate the velocity of the ball towards the middle goal
+    if (leftPlayerServe) {
+        ball.dx = Config::ballSpeedX; // Ball moves towards the right
+    }
+    else {
+        ball.dx = -Config::ballSpeedX; // Ball moves towards the left
+    }
+    ball.dy = 0; // Ball moves straight (no vertical component)
+    // Pause before the serve (skipped by headless runs)
+    if (servePauseMs > 0) {
+        SDL_Delay(servePauseMs);
+    }
+}
+
+// Function to check collision between two rectangles
+bool checkCollision(const SDL_Rect& rectA, const SDL_Rect& rectB) {
+    return (rectA.x + rectA.w >= rectB.x && rectB.x + rectB.w >= rectA.x && rectA.y + rectA.h >= rectB.y && rectB.y + rectB.h >= rectA.y);
+}
+
+// Function to update game state
+template <typename Config>
+static void updateKernel() {
+    const int diameter = 2 * Config::ballRadius;
+    const int goalTop = (SCREEN_HEIGHT - Config::goalHeight) / 2;
+    const int goalBottom = goalTop + Config::goalHeight;
+    const int zone = Config::paddleHeight / 3;
+
+    // Update ball position
+    ball.x += ball.dx;
+    ball.y += ball.dy;
+
+    // Define ballRect for collision detection
+    SDL_Rect ballRect = { static_cast<int>(ball.x), static_cast<int>(ball.y), diameter, diameter };
+
+    // Handle ball collisions with top and bottom borders
+    if (ball.y <= 0 || ball.y + diameter >= SCREEN_HEIGHT) {
+        gameSoundHandler(GameSound::WALL);
+        ball.dy = -ball.dy;
+    }
+    // Handle ball collisions with left and right walls (sides)
+    if (ball.x <= 0 || ball.x + diameter >= SCREEN_WIDTH) {
+        gameSoundHandler(GameSound::WALL);
+        ball.dx = -ball.dx;
+    }
+
+    // Handle ball collisions with left and right walls (goals)
+    if (ball.x <= Config::goalDepth) {
+        if (ball.y + Config::ballRadius >= goalTop && ball.y <= goalBottom) {
+            gameSoundHandler(GameSound::GOAL);
+            ++rightScore;
+            resetBallKernel<Config>(false); // Pass false to indicate right player serves next
+        }
+    }
+    else if (ball.x + diameter >= SCREEN_WIDTH - Config::goalDepth) {
+        if (ball.y + Config::ballRadius >= goalTop && ball.y <= goalBottom) {
+            gameSoundHandler(GameSound::GOAL);
+            ++leftScore;
+            resetBallKernel<Config>(true); // Pass true to indicate left player serves next
+        }
+    }
+
+    // Define paddle areas for collision detection
+    SDL_Rect leftPaddleTop = { leftPaddle.x, leftPaddle.y, Config::paddleWidth, zone };
+    SDL_Rect leftPaddleMiddle = { leftPaddle.x, leftPaddle.y + zone, Config::paddleWidth, zone };
+    SDL_Rect leftPaddleBottom = { leftPaddle.x, leftPaddle.y + 2 * zone, Config::paddleWidth, zone };
+    SDL_Rect rightPaddleTop = { rightPaddle.x, rightPaddle.y, Config::paddleWidth, zone };
+    SDL_Rect rightPaddleMiddle = { rightPaddle.x, rightPaddle.y + zone, Config::paddleWidth, zone };
+    SDL_Rect rightPaddleBottom = { rightPaddle.x, rightPaddle.y + 2 * zone, Config::paddleWidth, zone };
+
+    // Check for collision with left paddle
+    if (checkCollision(ballRect, leftPaddleTop)) {
+        gameSoundHandler(GameSound::PADDLE);
+        ball.dx = -ball.dx;
+        ball.dy = -Config::ballSpeedY; // Ball moves upward
+    }
+    else if (checkCollision(ballRect, leftPaddleMiddle)) {
+        gameSoundHandler(GameSound::PADDLE);
+        ball.dx = -ball.dx;
+        ball.dy = 0; // Ball moves straight
+    }
+    else if (checkCollision(ballRect, leftPaddleBottom)) {
+        gameSoundHandler(GameSound::PADDLE);
+        ball.dx = -ball.dx;
+        ball.dy = Config::ballSpeedY; // Ball moves downward
+    }
+
+    // Check for collision with right paddle
+    if (checkCollision(ballRect, rightPaddleTop)) {
+        gameSoundHandler(GameSound::PADDLE);
+        ball.dx = -ball.dx;
+        ball.dy = -Config::ballSpeedY; // Ball moves upward
+    }
+    else if (checkCollision(ballRect, rightPaddleMiddle)) {
+        gameSoundHandler(GameSound::PADDLE);
+        ball.dx = -ball.dx;
+        ball.dy = 0; // Ball moves straight
+    }
+    else if (checkCollision(ballRect, rightPaddleBottom)) {
+        gameSoundHandler(GameSound::PADDLE);
+        ball.dx = -ball.dx;
+        ball.dy = Config::ballSpeedY; // Ball moves downward
+    }
+
+    // Increment ball angle for rotation effect
+    ball.angle += 0.1;
+}
+
+// Function to move the paddle based on input
+template <typename Config>
+static void movePaddleKernel(Paddle& paddle, bool up, bool down) {
+    if (up && paddle.y > 0) {
+        paddle.y -= Config::paddleStep;
+    }
+    if (down && paddle.y < SCREEN_HEIGHT - Config::paddleHeight) {
+        paddle.y += Config::paddleStep;
+    }
+}
+
+// The simulation specialised for one variant
+struct GameKernels {
+    void (*resetPaddles)();
+    void (*resetBall)(bool leftPlayerServe);
+    void (*update)();
+    void (*movePaddle)(Paddle& paddle, bool up, bool down);
+};
+
+template <typename Config>
+static GameKernels kernelsOf() {
+    return { resetPaddlesKernel<Config>, resetBallKernel<Config>, updateKernel<Config>, movePaddleKernel<Config> };
+}
+
+static GameKernels kernels = kernelsOf<ClassicConfig>();
+
+template <typename Config>
+static void useVariant() {
+    kernels = kernelsOf<Config>();
+    tuning = tuningOf<Config>();
+    leftGoal = { 0, (SCREEN_HEIGHT - Config::goalHeight) / 2, Config::goalDepth, Config::goalHeight };
+    rightGoal = { SCREEN_WIDTH - Config::goalDepth, (SCREEN_HEIGHT - Config::goalHeight) / 2, Config::goalDepth, Config::goalHeight };
+}
+
+bool selectGameVariant(GameVariant variant) {
+    switch (variant) {
+    case GameVariant::CLASSIC:
+        useVariant<ClassicConfig>();
+        break;
+    case GameVariant::BIG_ARENA:
+        useVariant<BigArenaConfig>();
+        break;
+    case GameVariant::TRAINING:
+        useVariant<TrainingConfig>();
+        break;
+    case GameVariant::RUNTIME:
+        // Values from the command line have to leave room for the ball, the paddle zones and the goals
+        if (RuntimeConfig::paddleWidth <= 0 || RuntimeConfig::paddleHeight < 3 || RuntimeConfig::paddleHeight > SCREEN_HEIGHT ||
+            RuntimeConfig::paddleStep <= 0 || RuntimeConfig::ballRadius <= 0 || 2 * RuntimeConfig::ballRadius >= SCREEN_HEIGHT ||
+            RuntimeConfig::goalHeight <= 0 || RuntimeConfig::goalHeight > SCREEN_HEIGHT || RuntimeConfig::goalDepth <= 0 ||
+            RuntimeConfig::paddleInset + RuntimeConfig::paddleWidth >= SCREEN_WIDTH / 2) {
+            return false;
+        }
+        useVariant<RuntimeConfig>();
+        break;
+    }
+    return true;
+}
+
+bool parseGameVariant(const char* name, GameVariant& variant) {
+    static const struct {
+        const char* name;
+        GameVariant variant;
+    } names[] = { { "classic", GameVariant::CLASSIC }, { "big-arena", GameVariant::BIG_ARENA },
+                  { "training", GameVariant::TRAINING }, { "runtime", GameVariant::RUNTIME } };
+    for (const auto& entry : names) {
+        if (std::strcmp(name, entry.name) == 0) {
+            variant = entry.variant;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool setRuntimeTuning(const char* assignment) {
+    static const struct {
+        const char* name;
+        int* value;
+    } fields[] = { { "paddleWidth", &RuntimeConfig::paddleWidth }, { "paddleHeight", &RuntimeConfig::paddleHeight },
+                   { "paddleInset", &RuntimeConfig::paddleInset }, { "paddleStep", &RuntimeConfig::paddleStep },
+                   { "ballRadius", &RuntimeConfig::ballRadius }, { "ballSpeedX", &RuntimeConfig::ballSpeedX },
+                   { "ballSpeedY", &RuntimeConfig::ballSpeedY }, { "goalHeight", &RuntimeConfig::goalHeight },
+                   { "goalDepth", &RuntimeConfig::goalDepth }, { "circleRadius", &RuntimeConfig::circleRadius } };
+    const char* equals = std::strchr(assignment, '=');
+    if (equals == nullptr) {
+        return false;
+    }
+    size_t length = static_cast<size_t>(equals - assignment);
+    for (const auto& field : fields) {
+        if (std::strlen(field.name) == length && std::strncmp(assignment, field.name, length) == 0) {
+            *field.value = std::atoi(equals + 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+void resetPaddles() {
+    kernels.resetPaddles();
+}
+
+void resetBall(bool leftPlayerServe) {
+    TRACE_SCOPE("resetBall");
+    kernels.resetBall(leftPlayerServe);
+}
+
+void update() {
+    TRACE_SCOPE("update");
+    kernels.update();
+}
+
+void movePaddle(Paddle& paddle, bool up, bool down) {
+    kernels.movePaddle(paddle, up, down);
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include "gameconfig.h"
+#include <SDL.h>
+#include <cstring>
+#include <type_traits>
+
+// Constants for screen dimensions; everything else about the game is in gameconfig.h
+const int SCREEN_WIDTH = 800;
+const int SCREEN_HEIGHT = 600;
+
+// Structs to represent paddles and the ball
+struct Paddle {
+    int x, y;
+    int w, h;
+};
+
+struct Ball {
+    float x, y;
+    int r;
+    float dx, dy;
+    float angle;
+};
+
+// Sounds the simulation asks for
+enum class GameSound { WALL, PADDLE, GOAL };
+
+// Enumeration for menu options
+enum class MenuOption : Uint8 { START, QUIT };
+
+// Everything that changes while the game runs, kept together so rollback, replay seeking and
+// AI look-ahead can save or restore all of it with one memcpy
+struct alignas(64) GameState {
+    Ball ball;
+    Paddle leftPaddle, rightPaddle;
+    int leftScore, rightScore;
+    bool leftPlayerServe;       // who serves after the next goal
+    MenuOption selectedOption;
+};
+static_assert(std::is_trivially_copyable<GameState>::value, "GameState must stay copyable with memcpy");
+
+extern GameState gameState;
+
+// Variables for paddles, ball, goal areas, and scores (the mutable ones are fields of gameState)
+extern Paddle& leftPaddle;
+extern Paddle& rightPaddle;
+extern Ball& ball;
+extern SDL_Rect leftGoal;
+extern SDL_Rect rightGoal;
+extern int& leftScore;
+extern int& rightScore;
+
+// Functions to copy the whole game state out and back in
+inline void saveGameState(GameState& state) {
+    std::memcpy(&state, &gameState, sizeof(GameState));
+}
+
+inline void loadGameState(const GameState& state) {
+    std::memcpy(&gameState, &state, sizeof(GameState));
+}
+
+// Sound hook and serve pause, so the simulation runs without audio or waiting when headless
+extern void (*gameSoundHandler)(GameSound sound);
+extern Uint32 servePauseMs;
+
+// Function to swallow game sounds: the handler until a mixer is hooked up, for headless runs and
+// while re-simulating ticks that were already heard
+void silentGameSound(GameSound sound);
+
+// Values of the active variant, and function to switch variant (kernels, goal rectangles and tuning).
+// Returns false if the runtime variant's values don't fit the field.
+extern GameTuning tuning;
+bool selectGameVariant(GameVariant variant);
+
+// Function to parse a variant name (classic, big-arena, training, runtime)
+bool parseGameVariant(const char* name, GameVariant& variant);
+
+// Function to set one RuntimeConfig value from "name=value"
+bool setRuntimeTuning(const char* assignment);
+
+// Function to put both paddles back at their starting positions
+void resetPaddles();
+
+// Function to reset the ball to its initial state
+void resetBall(bool leftPlayerServe);
+
+// Function to check collision between two rectangles
+bool checkCollision(const SDL_Rect& rectA, const SDL_Rect& rectB);
+
+// Function to update game state
+void update();
+
+// Function to move the paddle based on input
+void movePaddle(Paddle& paddle, bool up, bool down);
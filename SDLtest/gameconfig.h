@@ -0,0 +1,67 @@
+#pragma once
+
+// Tuning of one game variant. The simulation kernels are templates on these types, so every value
+// is folded into the specialised code (the paddle zone size included) instead of being loaded at run time.
+// The field stays SCREEN_WIDTH x SCREEN_HEIGHT in every variant.
+struct ClassicConfig {
+    static constexpr int paddleWidth = 20;
+    static constexpr int paddleHeight = 100;
+    static constexpr int paddleInset = 20;      // gap between a side wall and its paddle
+    static constexpr int paddleStep = 5;        // px a paddle moves per tick
+    static constexpr int ballRadius = 10;
+    static constexpr int ballSpeedX = 8;        // px per tick
+    static constexpr int ballSpeedY = 8;        // after an edge-zone paddle hit
+    static constexpr int goalHeight = 300;
+    static constexpr int goalDepth = 10;
+    static constexpr int circleRadius = 80;     // centre circle, drawn only
+};
+
+// Wide goals, short paddles, a faster ball
+struct BigArenaConfig : ClassicConfig {
+    static constexpr int paddleHeight = 72;
+    static constexpr int paddleStep = 6;
+    static constexpr int ballRadius = 8;
+    static constexpr int ballSpeedX = 10;
+    static constexpr int ballSpeedY = 10;
+    static constexpr int goalHeight = 420;
+    static constexpr int circleRadius = 120;
+};
+
+// Practice: tall paddles, a slow ball and narrow goals
+struct TrainingConfig : ClassicConfig {
+    static constexpr int paddleHeight = 150;
+    static constexpr int ballSpeedX = 5;
+    static constexpr int ballSpeedY = 5;
+    static constexpr int goalHeight = 180;
+};
+
+// Variant for experiments: the same names as plain variables, set from the command line (--tune name=value).
+// Starts out with the classic values.
+struct RuntimeConfig {
+    static int paddleWidth;
+    static int paddleHeight;
+    static int paddleInset;
+    static int paddleStep;
+    static int ballRadius;
+    static int ballSpeedX;
+    static int ballSpeedY;
+    static int goalHeight;
+    static int goalDepth;
+    static int circleRadius;
+};
+
+enum class GameVariant { CLASSIC, BIG_ARENA, TRAINING, RUNTIME };
+
+// Values of the active variant for code that isn't specialised (rendering, AI, the multiball arena)
+struct GameTuning {
+    int paddleWidth, paddleHeight, paddleInset, paddleStep;
+    int ballRadius, ballSpeedX, ballSpeedY;
+    int goalHeight, goalDepth, circleRadius;
+};
+
+template <typename Config>
+inline GameTuning tuningOf() {
+    return { Config::paddleWidth, Config::paddleHeight, Config::paddleInset, Config::paddleStep,
+             Config::ballRadius, Config::ballSpeedX, Config::ballSpeedY,
+             Config::goalHeight, Config::goalDepth, Config::circleRadius };
+}
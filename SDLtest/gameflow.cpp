@@ -0,0 +1,122 @@
+#include "gameflow.h"
+#include <cstdlib>
+#include <iostream>
+
+// Frame pool: blocks handed out from a free list, no heap involved
+alignas(std::max_align_t) static unsigned char frameBlocks[FLOW_FRAME_BLOCKS][FLOW_FRAME_BLOCK_SIZE];
+static int freeBlocks[FLOW_FRAME_BLOCKS];
+static int freeCount = -1;  // -1 until the free list is first filled
+
+// The one coroutine waiting to be resumed, and what it waits for
+enum class FlowWait { NONE, TICKS, EVENT };
+static std::coroutine_handle<> waiting;
+static FlowWait waitKind = FlowWait::NONE;
+static int ticksLeft = 0;
+static Uint32 eventType = 0;
+static SDL_Event lastEvent;
+static Uint32 currentTickEnd = 0;
+
+static FlowTask topLevel;
+static bool flowActive = false;
+
+// Phase in the low byte, its value above it, so readers always see a matching pair
+static std::atomic<int> phaseWord(static_cast<int>(FlowPhase::MENU));
+
+void* flowFrameAlloc(size_t size) {
+    if (freeCount < 0) {
+        for (int i = 0; i < FLOW_FRAME_BLOCKS; ++i) {
+            freeBlocks[i] = FLOW_FRAME_BLOCKS - 1 - i;
+        }
+        freeCount = FLOW_FRAME_BLOCKS;
+    }
+    if (size > FLOW_FRAME_BLOCK_SIZE || freeCount == 0) {
+        std::cerr << "Game flow frame of " << size << " bytes doesn't fit the pool (" << freeCount << " of "
+                  << FLOW_FRAME_BLOCKS << " blocks of " << FLOW_FRAME_BLOCK_SIZE << " bytes free)" << std::endl;
+        std::abort();
+    }
+    return frameBlocks[freeBlocks[--freeCount]];
+}
+
+void flowFrameFree(void* frame) {
+    int index = static_cast<int>((static_cast<unsigned char*>(frame) - &frameBlocks[0][0]) / FLOW_FRAME_BLOCK_SIZE);
+    freeBlocks[freeCount++] = index;
+}
+
+void WaitTicks::await_suspend(std::coroutine_handle<> awaiting) noexcept {
+    waiting = awaiting;
+    waitKind = FlowWait::TICKS;
+    ticksLeft = ticks;
+}
+
+void WaitEvent::await_suspend(std::coroutine_handle<> awaiting) noexcept {
+    waiting = awaiting;
+    waitKind = FlowWait::EVENT;
+    eventType = type;
+}
+
+SDL_Event WaitEvent::await_resume() const noexcept {
+    return lastEvent;
+}
+
+// Function to resume whatever is waiting; it runs until its next wait or the end of the flow
+static void resumeWaiting() {
+    std::coroutine_handle<> handle = waiting;
+    waiting = nullptr;
+    waitKind = FlowWait::NONE;
+    handle.resume();
+    if (topLevel.handle.done()) {
+        setFlowPhase(FlowPhase::DONE);
+    }
+}
+
+void startGameFlow(FlowTask flow) {
+    topLevel = static_cast<FlowTask&&>(flow);
+    flowActive = true;
+    waiting = topLevel.handle;
+    resumeWaiting();
+}
+
+void tickFlow(Uint32 tickEnd) {
+    currentTickEnd = tickEnd;
+    if (waitKind == FlowWait::TICKS && --ticksLeft <= 0) {
+        resumeWaiting();
+    }
+}
+
+bool dispatchFlowEvent(const SDL_Event& e) {
+    if (waitKind != FlowWait::EVENT || e.type != eventType) {
+        return false;
+    }
+    lastEvent = e;
+    resumeWaiting();
+    return true;
+}
+
+Uint32 flowTickEnd() {
+    return currentTickEnd;
+}
+
+void stopGameFlow() {
+    topLevel = FlowTask();
+    waiting = nullptr;
+    waitKind = FlowWait::NONE;
+    flowActive = false;
+}
+
+bool gameFlowActive() {
+    return flowActive;
+}
+
+void setFlowPhase(FlowPhase phase, int value) {
+    phaseWord.store(static_cast<int>(phase) | (value << 8), std::memory_order_release);
+}
+
+FlowPhase flowPhase() {
+    return static_cast<FlowPhase>(phaseWord.load(std::memory_order_acquire) & 0xFF);
+}
+
+FlowPhase flowPhase(int& value) {
+    int word = phaseWord.load(std::memory_order_acquire);
+    value = word >> 8;
+    return static_cast<FlowPhase>(word & 0xFF);
+}
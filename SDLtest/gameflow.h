@@ -0,0 +1,134 @@
+#pragma once
+#include <SDL.h>
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+
+// Coroutine frames come from a fixed pool: enough blocks for the deepest chain of stages alive at once
+const int FLOW_FRAME_BLOCKS = 8;
+const size_t FLOW_FRAME_BLOCK_SIZE = 1024;
+
+// Stage of the game flow, for the loop (menu or game), the renderer's banner and the simulation thread
+enum class FlowPhase : int {
+    MENU,
+    COUNTDOWN,      // value: seconds left before the serve
+    RALLY,
+    GOAL,           // value: 0 left scored, 1 right scored
+    MATCH_END,      // value: 0 left won, 1 right won
+    DONE            // the player chose Quit
+};
+
+// Function to take and return coroutine frames. The pool is sized for the flow, so running out
+// (or a frame outgrowing a block) is a bug and aborts rather than falling back to the heap.
+void* flowFrameAlloc(size_t size);
+void flowFrameFree(void* frame);
+
+// A stage of the game flow: starts suspended, runs when awaited and hands back an int (a menu choice,
+// the side that scored or won) when it co_returns
+struct FlowTask {
+    struct promise_type;
+    typedef std::coroutine_handle<promise_type> Handle;
+
+    // When a stage finishes, control goes straight back to the stage that awaited it
+    struct FinalAwaiter {
+        bool await_ready() noexcept { return false; }
+        std::coroutine_handle<> await_suspend(Handle handle) noexcept {
+            std::coroutine_handle<> continuation = handle.promise().continuation;
+            return continuation ? continuation : std::noop_coroutine();
+        }
+        void await_resume() noexcept {}
+    };
+
+    struct promise_type {
+        std::coroutine_handle<> continuation;
+        int result = 0;
+
+        FlowTask get_return_object() { return FlowTask(Handle::from_promise(*this)); }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        FinalAwaiter final_suspend() noexcept { return {}; }
+        void return_value(int value) { result = value; }
+        void unhandled_exception() { std::terminate(); }
+
+        static void* operator new(size_t size) { return flowFrameAlloc(size); }
+        static void operator delete(void* frame) { flowFrameFree(frame); }
+    };
+
+    FlowTask() : handle(nullptr) {}
+    explicit FlowTask(Handle handle) : handle(handle) {}
+    FlowTask(FlowTask&& other) noexcept : handle(other.handle) { other.handle = nullptr; }
+    FlowTask& operator=(FlowTask&& other) noexcept {
+        if (this != &other) {
+            if (handle) {
+                handle.destroy();
+            }
+            handle = other.handle;
+            other.handle = nullptr;
+        }
+        return *this;
+    }
+    FlowTask(const FlowTask&) = delete;
+    FlowTask& operator=(const FlowTask&) = delete;
+    ~FlowTask() {
+        if (handle) {
+            handle.destroy();
+        }
+    }
+
+    // Awaiting a stage runs it to completion (across as many ticks as it takes) and yields its result
+    bool await_ready() const noexcept { return !handle || handle.done(); }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+        handle.promise().continuation = awaiting;
+        return handle;
+    }
+    int await_resume() const noexcept { return handle ? handle.promise().result : 0; }
+
+    Handle handle;
+};
+
+// Awaitable: resume after this many calls to tickFlow() (1 = the next tick)
+struct WaitTicks {
+    int ticks;
+    bool await_ready() const noexcept { return ticks <= 0; }
+    void await_suspend(std::coroutine_handle<> awaiting) noexcept;
+    void await_resume() const noexcept {}
+};
+
+// Awaitable: resume on the next event of this SDL type handed to dispatchFlowEvent(), which it yields
+struct WaitEvent {
+    Uint32 type;
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> awaiting) noexcept;
+    SDL_Event await_resume() const noexcept;
+};
+
+inline WaitTicks waitTicks(int ticks) {
+    return { ticks };
+}
+
+inline WaitEvent waitEvent(Uint32 type) {
+    return { type };
+}
+
+// Function to start the top-level stage and run it to its first wait
+void startGameFlow(FlowTask flow);
+
+// Function to advance the flow by one simulation tick; tickEnd is available to the stages through flowTickEnd()
+void tickFlow(Uint32 tickEnd);
+
+// Function to hand an event to a stage waiting for one of its type, returns true if one was
+bool dispatchFlowEvent(const SDL_Event& e);
+
+// Function to get the end of the tick the flow is being resumed for
+Uint32 flowTickEnd();
+
+// Function to destroy the flow wherever it is suspended, returning its frames to the pool
+void stopGameFlow();
+
+// Function to check whether a flow was started and hasn't been stopped
+bool gameFlowActive();
+
+// Functions to publish and read the current stage, and the value that goes with it; safe across threads
+void setFlowPhase(FlowPhase phase, int value = 0);
+FlowPhase flowPhase();
+FlowPhase flowPhase(int& value);
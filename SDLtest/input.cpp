@@ -0,0 +1,74 @@
+#include "input.h"
+#include <atomic>
+
+// Keys the game reacts to, in PaddleInput order
+static const SDL_Scancode PADDLE_KEYS[4] = { SDL_SCANCODE_W, SDL_SCANCODE_S, SDL_SCANCODE_UP, SDL_SCANCODE_DOWN };
+
+static InputEvent inputBuffer[INPUT_BUFFER_SIZE];
+static std::atomic<unsigned> inputHead(0);  // next slot recordInputEvent() writes
+static std::atomic<unsigned> inputTail(0);  // next slot sampleTickInput() reads
+static bool keyHeld[4] = { false, false, false, false };
+
+// Function to map a scancode to its slot in PADDLE_KEYS, -1 if the game ignores it
+static int paddleKeyIndex(SDL_Scancode scancode) {
+    for (int i = 0; i < 4; ++i) {
+        if (PADDLE_KEYS[i] == scancode) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void resetInput() {
+    inputHead = 0;
+    inputTail = 0;
+    const Uint8* currentKeyStates = SDL_GetKeyboardState(NULL);
+    for (int i = 0; i < 4; ++i) {
+        keyHeld[i] = currentKeyStates[PADDLE_KEYS[i]] != 0;
+    }
+}
+
+void recordInputEvent(const SDL_Event& e) {
+    if ((e.type != SDL_KEYDOWN && e.type != SDL_KEYUP) || e.key.repeat) {
+        return;
+    }
+    if (paddleKeyIndex(e.key.keysym.scancode) < 0) {
+        return;
+    }
+    unsigned head = inputHead.load(std::memory_order_relaxed);
+    if (head - inputTail.load(std::memory_order_acquire) == INPUT_BUFFER_SIZE) {
+        return;
+    }
+    inputBuffer[head % INPUT_BUFFER_SIZE] = { e.key.timestamp, e.key.keysym.scancode, e.type == SDL_KEYDOWN };
+    inputHead.store(head + 1, std::memory_order_release);
+}
+
+PaddleInput sampleTickInput(Uint32 tickEnd) {
+    bool active[4];
+    for (int i = 0; i < 4; ++i) {
+        active[i] = keyHeld[i];
+    }
+
+    // Events come out in arrival order, which SDL guarantees is timestamp order
+    unsigned tail = inputTail.load(std::memory_order_relaxed);
+    unsigned head = inputHead.load(std::memory_order_acquire);
+    for (; tail != head; ++tail) {
+        const InputEvent& event = inputBuffer[tail % INPUT_BUFFER_SIZE];
+        if (static_cast<Sint32>(event.timestamp - tickEnd) >= 0) {
+            break; // Belongs to a later tick
+        }
+        int key = paddleKeyIndex(event.scancode);
+        keyHeld[key] = event.down;
+        if (event.down) {
+            active[key] = true;
+        }
+    }
+    inputTail.store(tail, std::memory_order_release);
+
+    PaddleInput input;
+    input.leftUp = active[0];
+    input.leftDown = active[1];
+    input.rightUp = active[2];
+    input.rightDown = active[3];
+    return input;
+}
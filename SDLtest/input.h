@@ -0,0 +1,33 @@
+#pragma once
+#include <SDL.h>
+
+// Length of one simulation tick in milliseconds
+const Uint32 TICK_MS = 10;
+// Key events remembered between ticks (power of two), newest are dropped when full
+const int INPUT_BUFFER_SIZE = 256;
+
+// A key transition as reported by SDL, with its event timestamp
+struct InputEvent {
+    Uint32 timestamp;
+    SDL_Scancode scancode;
+    bool down;
+};
+
+// Paddle controls for one simulation tick
+struct PaddleInput {
+    bool leftUp, leftDown;
+    bool rightUp, rightDown;
+};
+
+// Function to clear the buffer and take the currently held keys as the starting state
+void resetInput();
+
+// Function to store a SDL_KEYDOWN/SDL_KEYUP event in the ring buffer (other events are ignored).
+// The buffer is lock-free with one producer and one consumer, so the event thread can record while
+// the simulation thread samples.
+void recordInputEvent(const SDL_Event& e);
+
+// Function to consume every event before tickEnd and return the controls for that tick.
+// A key counts as pressed for the tick if it was held at the start or went down at any
+// point inside it, so taps shorter than a tick still move the paddle.
+PaddleInput sampleTickInput(Uint32 tickEnd);
@@ -0,0 +1,134 @@
+#include "latency.h"
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+static const int STAGE_COUNT = static_cast<int>(LatencyStage::COUNT);
+static const char* STAGE_NAMES[STAGE_COUNT] = { "pushed", "polled", "input", "move", "update", "render", "present" };
+
+static bool probeEnabled = false;
+static int probeSamples = 0;
+static int probeKeyIndex = 0;       // alternates W and S so the paddle never parks against a wall
+static bool probeInFlight = false;
+static int probeWaitFrames = 0;
+static Uint64 stageTimes[STAGE_COUNT];
+static bool stageSeen[STAGE_COUNT];
+// Microseconds between consecutive stages, plus one extra row for pushed -> present
+static std::vector<Uint64> stageDeltas[STAGE_COUNT];
+
+// Function to push a synthesized key event as if the player had pressed or released it
+static void pushProbeKey(SDL_Scancode scancode, SDL_Keycode sym, bool down) {
+    SDL_Event event;
+    SDL_memset(&event, 0, sizeof(event));
+    event.type = down ? SDL_KEYDOWN : SDL_KEYUP;
+    event.key.state = down ? SDL_PRESSED : SDL_RELEASED;
+    event.key.keysym.scancode = scancode;
+    event.key.keysym.sym = sym;
+    SDL_PushEvent(&event);
+}
+
+void startLatencyProbe(int samples) {
+    probeEnabled = true;
+    probeSamples = samples;
+    probeWaitFrames = 10; // let the first frames settle
+    for (std::vector<Uint64>& deltas : stageDeltas) {
+        deltas.reserve(samples);
+    }
+}
+
+bool latencyProbeActive() {
+    return probeEnabled;
+}
+
+bool latencyProbeStep() {
+    if (static_cast<int>(stageDeltas[0].size()) >= probeSamples) {
+        return false;
+    }
+    if (probeInFlight) {
+        return true;
+    }
+    if (probeWaitFrames > 0) {
+        --probeWaitFrames;
+        return true;
+    }
+
+    for (bool& seen : stageSeen) {
+        seen = false;
+    }
+    probeInFlight = true;
+    latencyMark(LatencyStage::PUSHED);
+    if (probeKeyIndex == 0) {
+        pushProbeKey(SDL_SCANCODE_W, SDLK_w, true);
+    }
+    else {
+        pushProbeKey(SDL_SCANCODE_S, SDLK_s, true);
+    }
+    return true;
+}
+
+void latencyMark(LatencyStage stage) {
+    int index = static_cast<int>(stage);
+    // Only record a stage once, and only after the one before it
+    if (!probeInFlight || stageSeen[index] || (index > 0 && !stageSeen[index - 1])) {
+        return;
+    }
+    stageTimes[index] = SDL_GetPerformanceCounter();
+    stageSeen[index] = true;
+    if (stage != LatencyStage::PRESENT) {
+        return;
+    }
+
+    Uint64 frequency = SDL_GetPerformanceFrequency();
+    for (int i = 1; i < STAGE_COUNT; ++i) {
+        stageDeltas[i].push_back((stageTimes[i] - stageTimes[i - 1]) * 1000000 / frequency);
+    }
+    stageDeltas[0].push_back((stageTimes[STAGE_COUNT - 1] - stageTimes[0]) * 1000000 / frequency);
+
+    // Release the key and vary the gap so presses land at different points within a tick
+    if (probeKeyIndex == 0) {
+        pushProbeKey(SDL_SCANCODE_W, SDLK_w, false);
+    }
+    else {
+        pushProbeKey(SDL_SCANCODE_S, SDLK_s, false);
+    }
+    probeKeyIndex ^= 1;
+    probeInFlight = false;
+    probeWaitFrames = 2 + static_cast<int>(stageDeltas[0].size() % 4);
+}
+
+// Function to print one row of the report
+static void printDistribution(const char* name, std::vector<Uint64>& deltas) {
+    if (deltas.empty()) {
+        return;
+    }
+    std::sort(deltas.begin(), deltas.end());
+    Uint64 total = 0;
+    for (Uint64 delta : deltas) {
+        total += delta;
+    }
+    size_t n = deltas.size();
+    std::cout << std::setw(18) << name
+        << std::setw(10) << deltas[0] / 1000.0
+        << std::setw(10) << deltas[n / 2] / 1000.0
+        << std::setw(10) << total / n / 1000.0
+        << std::setw(10) << deltas[n * 95 / 100] / 1000.0
+        << std::setw(10) << deltas[n * 99 / 100] / 1000.0
+        << std::setw(10) << deltas[n - 1] / 1000.0 << std::endl;
+}
+
+void reportLatencyProbe() {
+    if (!probeEnabled) {
+        return;
+    }
+    std::cout << "Input-to-photon latency over " << stageDeltas[0].size() << " key presses (ms)" << std::endl;
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << std::setw(18) << "stage" << std::setw(10) << "min" << std::setw(10) << "p50" << std::setw(10) << "avg"
+        << std::setw(10) << "p95" << std::setw(10) << "p99" << std::setw(10) << "max" << std::endl;
+    for (int i = 1; i < STAGE_COUNT; ++i) {
+        std::string name = std::string(STAGE_NAMES[i - 1]) + "->" + STAGE_NAMES[i];
+        printDistribution(name.c_str(), stageDeltas[i]);
+    }
+    printDistribution("total", stageDeltas[0]);
+}
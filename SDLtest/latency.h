@@ -0,0 +1,29 @@
+#pragma once
+#include <SDL.h>
+
+// Points a probed key press passes on its way to the screen, in order
+enum class LatencyStage {
+    PUSHED,         // SDL_PushEvent called
+    POLLED,         // SDL_PollEvent returned it to the main loop
+    INPUT,          // handleGameInput() saw it in a tick's PaddleInput
+    MOVE,           // movePaddle() applied it
+    UPDATE,         // update() finished the tick
+    RENDER,         // render() finished submitting the frame
+    PRESENT,        // SDL_RenderPresent() returned
+    COUNT
+};
+
+// Function to enable the probe: samples synthesized key presses, then stops the game
+void startLatencyProbe(int samples);
+
+// Function to check whether the game is running as a latency probe
+bool latencyProbeActive();
+
+// Function to drive the probe once per main loop iteration, returns false when all samples are in
+bool latencyProbeStep();
+
+// Function to timestamp a stage of the key press currently in flight
+void latencyMark(LatencyStage stage);
+
+// Function to print per-stage and total latency distributions
+void reportLatencyProbe();
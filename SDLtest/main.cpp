@@ -3,17 +3,41 @@
 #include <SDL_image.h>
 #include <SDL_mixer.h>
 #include <iostream>
-#include <sstream>
 #include <cmath>
-
-// Constants for screen dimensions and game elements
-const int SCREEN_WIDTH = 800;
-const int SCREEN_HEIGHT = 600;
-const int PADDLE_WIDTH = 20;
-const int PADDLE_HEIGHT = 100;
-const int BALL_RADIUS = 10;
-const int BALL_SPEED_X = 8;
-const int BALL_SPEED_Y = 8;
+#include <cstdlib>
+#include <cstring>
+#include "ai.h"
+#include "allocguard.h"
+#include "audio.h"
+#include "capture.h"
+#include "dirtyrect.h"
+#include "framearena.h"
+#include "game.h"
+#include "gameflow.h"
+#include "input.h"
+#include "latency.h"
+#include "menuidle.h"
+#include "microbench.h"
+#include "multiball.h"
+#include "netplay.h"
+#include "perfhud.h"
+#include "raster.h"
+#include "replay.h"
+#include "simthread.h"
+#include "resolution.h"
+#include "spectator.h"
+#include "spritebatch.h"
+#include "statering.h"
+#include "trace.h"
+#include "windowstate.h"
+
+// Most ticks simulated per loop iteration before the clock is resynced
+const int MAX_TICKS_PER_FRAME = 5;
+// Lengths of the timed stages of the game flow
+const int TICKS_PER_SECOND = 1000 / TICK_MS;
+const int SERVE_COUNTDOWN_SECONDS = 2;
+const int GOAL_CELEBRATION_TICKS = TICKS_PER_SECOND;
+const int MATCH_END_TICKS = 3 * TICKS_PER_SECOND;
 
 // Global variables for SDL window, renderer, font, and menu texture
 SDL_Window* gWindow = nullptr;
@@ -21,39 +45,87 @@ SDL_Renderer* gRenderer = nullptr;
 TTF_Font* gFont = nullptr;
 SDL_Texture* menuTexture = nullptr;
 
-// Structs to represent paddles and the ball
-struct Paddle {
-    int x, y;
-    int w, h;
-};
-
-struct Ball {
-    float x, y;
-    int r;
-    float dx, dy;
-    float angle;
-};
-
-// Variables for paddles, ball, goal areas, and scores
-Paddle leftPaddle, rightPaddle;
-Ball ball;
-SDL_Rect leftGoal = { 0, (SCREEN_HEIGHT - 300) / 2, 10, 300 };
-SDL_Rect rightGoal = { SCREEN_WIDTH - 10, (SCREEN_HEIGHT - 300) / 2, 10, 300 };
-int leftScore = 0;
-int rightScore = 0;
-
-// Enumeration for menu options
-enum class MenuOption { START, QUIT };
-MenuOption selectedOption = MenuOption::START;
+// Menu selection, part of the game state
+MenuOption& selectedOption = gameState.selectedOption;
 // Global variable for the goal sound
 Mix_Chunk* goalSound = nullptr;
 // Global variable for the paddles sound
 Mix_Chunk* paddleSound = nullptr;
 // Global variable for the paddles sound
 Mix_Chunk* wallSound = nullptr;
+// Buffer size of the low-latency mixer in frames, 0 keeps SDL_mixer playback
+int lowLatencyAudioFrames = 0;
+// Computer players, a disabled controller leaves the paddle to the keyboard
+AiController leftAi;
+AiController rightAi;
+// Network match state, only used when --host or --join was given
+bool netplayActive = false;
+UdpTransport netTransport;
+RollbackSession netSession;
+// Replay being recorded (--record) or played back (--play-replay)
+const char* recordPath = nullptr;
+ReplayWriter replayWriter;
+bool replayPlayback = false;
+ReplayReader replayReader;
+// Playback controls: ticks simulated per real tick (1-64) and pause
+const int MAX_PLAYBACK_SPEED = 64;
+int playbackSpeed = 1;
+bool playbackPaused = false;
+// Multiball arena (--multiball), replaces the single ball when active
+bool arenaActive = false;
+BallArena arena;
+int arenaBalls = 0;
+// Live spectating: this game streaming to others (--spectator-port), or watching one (--spectate)
+Uint16 spectatorPort = 0;
+SpectatorServer spectatorServer;
+Uint32 spectatorTick = 0;
+bool spectating = false;
+SpectatorClient spectatorClient;
+// Fixed-rate simulation on its own thread (--sim-thread); the renderer then draws the newest
+// snapshot it published instead of the game globals
+bool simThreadRequested = false;
+const GameState* drawnState = &gameState;
+// Run without a visible window or real audio device (dummy drivers, software renderer)
+bool headless = false;
+// Frame-time budget in ms the internal resolution is scaled to hold (--frame-budget), 0 renders at native size
+float frameBudgetMs = 0.0f;
+// Software renderer that only repaints and presents what moved (--dirty-rects)
+bool dirtyRects = false;
+// Microbenchmark run (--bench [filter]) and where to write its JSON results (--bench-json path)
+const char* benchFilter = nullptr;
+const char* benchJsonPath = nullptr;
+// Screen recording to PNGs or a Y4M video (--capture path [fps])
+const char* capturePath = nullptr;
+int captureFps = CAPTURE_DEFAULT_FPS;
+// Offline rendering through the tile rasterizer (--raster-export, --raster-bench); while a frame
+// is being recorded the scene draws into rasterTarget instead of gRenderer
+RasterFrame* rasterTarget = nullptr;
+const char* rasterExportPath = nullptr;
+int rasterExportWidth = SCREEN_WIDTH;
+int rasterExportHeight = SCREEN_HEIGHT;
+int rasterBenchWidth = 3840;
+int rasterBenchHeight = 2160;
+int rasterBenchFrames = 0;
+int rasterThreads = 0;
+// Goals that win a match (--match-points), 0 plays on forever, as multiball always does
+int matchPoints = 7;
+// Chrome/Perfetto trace of frame phases and subsystem spans (--trace path)
+const char* tracePath = nullptr;
+
+// Function to decode a sound effect
+Mix_Chunk* loadSound(const char* path) {
+    TRACE_SCOPE("load sound");
+    return Mix_LoadWAV(path);
+}
 
 // Function to initialize SDL, SDL_ttf, and SDL_image
 bool initialize() {
+    TRACE_SCOPE("initialize");
+    if (headless) {
+        SDL_SetHint(SDL_HINT_VIDEODRIVER, "dummy");
+        SDL_SetHint(SDL_HINT_AUDIODRIVER, "dummy");
+    }
+
     // Initialize SDL
     if (SDL_Init(SDL_INIT_VIDEO) < 0) {
         std::cerr << "SDL could not initialize! SDL_Error: " << SDL_GetError() << std::endl;
@@ -80,19 +152,42 @@ bool initialize() {
     }
 
     // Create renderer
-    gRenderer = SDL_CreateRenderer(gWindow, -1, SDL_RENDERER_ACCELERATED);
+    if (dirtyRects) {
+        gRenderer = createDirtyRectRenderer(gWindow);
+    }
+    else {
+        gRenderer = SDL_CreateRenderer(gWindow, -1, headless ? SDL_RENDERER_SOFTWARE : SDL_RENDERER_ACCELERATED);
+    }
     if (gRenderer == nullptr) {
         std::cerr << "Renderer could not be created! SDL_Error: " << SDL_GetError() << std::endl;
         return false;
     }
 
     // Load font
-    gFont = TTF_OpenFont("vtks chalk 79.ttf", 28);
+    {
+        TRACE_SCOPE("load font");
+        gFont = TTF_OpenFont("vtks chalk 79.ttf", 28);
+    }
     if (gFont == nullptr) {
         std::cerr << "Failed to load font! SDL_ttf Error: " << TTF_GetError() << std::endl;
         return false;
     }
 
+    // Bake every glyph the UI draws into the texture atlas
+    bool atlasBuilt;
+    {
+        TRACE_SCOPE("build atlas");
+        createAtlas();
+        atlasBuilt = atlasAddFont(AtlasFont::MENU, "vtks chalk 79.ttf", 48, TTF_STYLE_NORMAL) &&
+            atlasAddFont(AtlasFont::SCORE, "score.ttf", 48, TTF_STYLE_NORMAL) &&
+            atlasAddFont(AtlasFont::HUD, "arial.ttf", 14, TTF_STYLE_NORMAL) &&
+            finalizeAtlas(gRenderer);
+    }
+    if (!atlasBuilt) {
+        std::cerr << "Failed to build texture atlas!" << std::endl;
+        return false;
+    }
+
     // Initialize SDL_mixer
     if (Mix_OpenAudio(44100, MIX_DEFAULT_FORMAT, 2, 2048) < 0) {
         std::cerr << "SDL_mixer could not initialize! SDL_mixer Error: " << Mix_GetError() << std::endl;
@@ -100,37 +195,50 @@ bool initialize() {
     }
 
     // Load the goal sound
-    goalSound = Mix_LoadWAV("goal.mp3");
+    goalSound = loadSound("goal.mp3");
     if (goalSound == nullptr) {
         std::cerr << "Failed to load goal sound! SDL_mixer Error: " << Mix_GetError() << std::endl;
         return false;
     }
 
     // Load the paddle sound
-    paddleSound = Mix_LoadWAV("paddle.mp3");
+    paddleSound = loadSound("paddle.mp3");
     if (paddleSound == nullptr) {
         std::cerr << "Failed to load paddle sound! SDL_mixer Error: " << Mix_GetError() << std::endl;
         return false;
     }
 
     // Load the wall sound
-    wallSound = Mix_LoadWAV("wallsound.mp3");
+    wallSound = loadSound("wallsound.mp3");
     if (paddleSound == nullptr) {
         std::cerr << "Failed to load wall sound! SDL_mixer Error: " << Mix_GetError() << std::endl;
         return false;
     }
 
+    // Switch to the in-house mixer once the effects are decoded
+    if (lowLatencyAudioFrames > 0 && !openLowLatencyMixer(lowLatencyAudioFrames)) {
+        std::cerr << "Failed to open low-latency mixer!" << std::endl;
+        return false;
+    }
+
     return true;
 }
 
 // Function to free resources and close SDL
 void close() {
+    closeLowLatencyMixer();
+    destroyDynamicResolution();
+    destroyDirtyRects();
+    stopCapture();
+
     TTF_CloseFont(gFont);
     gFont = nullptr;
 
     SDL_DestroyTexture(menuTexture);
     menuTexture = nullptr;
 
+    destroyAtlas();
+
     Mix_FreeChunk(goalSound);
     goalSound = nullptr;
 
@@ -143,10 +251,40 @@ void close() {
     TTF_Quit();
     IMG_Quit();
     Mix_CloseAudio();
+    stopTrace();
+}
+
+// Function to play a sound effect through whichever mixer is active
+void playSound(Mix_Chunk* sound) {
+    if (lowLatencyMixerActive()) {
+        mixerPlay(sound);
+    }
+    else {
+        Mix_PlayChannel(-1, sound, 0);
+    }
+}
+
+// Function to route game sounds to the loaded effects
+void playGameSound(GameSound sound) {
+    switch (sound) {
+    case GameSound::WALL:
+        TRACE_INSTANT("wall sound");
+        playSound(wallSound);
+        break;
+    case GameSound::PADDLE:
+        TRACE_INSTANT("paddle sound");
+        playSound(paddleSound);
+        break;
+    case GameSound::GOAL:
+        TRACE_INSTANT("goal sound");
+        playSound(goalSound);
+        break;
+    }
 }
 
 // Function to load menu background texture
 bool loadMenuTexture() {
+    TRACE_SCOPE("load menu texture");
     SDL_Surface* loadedSurface = IMG_Load("menubg.jpg");
     if (loadedSurface == nullptr) {
         std::cerr << "Unable to load image! SDL_image Error: " << IMG_GetError() << std::endl;
@@ -157,328 +295,1026 @@ bool loadMenuTexture() {
         std::cerr << "Unable to create texture from image! SDL Error: " << SDL_GetError() << std::endl;
         return false;
     }
+    hudCount(HudCounter::TEXTURES);
     SDL_FreeSurface(loadedSurface);
     return true;
 }
 
 // Function to render the menu with options
 void renderMenu() {
+    TRACE_SCOPE("renderMenu");
     SDL_RenderClear(gRenderer);
     SDL_RenderCopy(gRenderer, menuTexture, NULL, NULL);
 
     SDL_Color textColor = { 255, 255, 255, 255 };
-    TTF_SetFontStyle(gFont, TTF_STYLE_BOLD);
 
-    TTF_Font* largeFont = TTF_OpenFont("vtks chalk 79.ttf", 48); // Larger font size for Quit
-    SDL_Surface* quitSurface = TTF_RenderText_Solid(largeFont, "Quit", textColor);
-    SDL_Texture* quitTexture = SDL_CreateTextureFromSurface(gRenderer, quitSurface);
-    int quitWidth, quitHeight;
-    SDL_QueryTexture(quitTexture, NULL, NULL, &quitWidth, &quitHeight);
+    int quitWidth = atlasTextWidth(AtlasFont::MENU, "Quit");
+    int quitHeight = atlasTextHeight(AtlasFont::MENU);
     SDL_Rect quitRect = { SCREEN_WIDTH - quitWidth - 20, SCREEN_HEIGHT - quitHeight - 20, quitWidth, quitHeight }; // Bottom-right corner with padding
     if (selectedOption == MenuOption::QUIT) {
         SDL_SetRenderDrawColor(gRenderer, 255, 255, 0, 255); // Yellow highlight color
         SDL_RenderDrawRect(gRenderer, &quitRect);
     }
-    SDL_RenderCopy(gRenderer, quitTexture, NULL, &quitRect);
-    SDL_FreeSurface(quitSurface);
-    SDL_DestroyTexture(quitTexture);
+    batchText(AtlasFont::MENU, "Quit", quitRect.x, quitRect.y, textColor);
 
-    SDL_Surface* startSurface = TTF_RenderText_Solid(largeFont, "Start", textColor);
-    SDL_Texture* startTexture = SDL_CreateTextureFromSurface(gRenderer, startSurface);
-    int startWidth, startHeight;
-    SDL_QueryTexture(startTexture, NULL, NULL, &startWidth, &startHeight);
+    int startWidth = atlasTextWidth(AtlasFont::MENU, "Start");
+    int startHeight = atlasTextHeight(AtlasFont::MENU);
     SDL_Rect startRect = { SCREEN_WIDTH - startWidth - 20, SCREEN_HEIGHT - quitHeight - startHeight - 40, startWidth, startHeight }; // Position "Start" above "Quit" with padding
     if (selectedOption == MenuOption::START) {
         SDL_SetRenderDrawColor(gRenderer, 255, 255, 0, 255); // Yellow highlight color
         SDL_RenderDrawRect(gRenderer, &startRect);
     }
-    SDL_RenderCopy(gRenderer, startTexture, NULL, &startRect);
-    SDL_FreeSurface(startSurface);
-    SDL_DestroyTexture(startTexture);
+    batchText(AtlasFont::MENU, "Start", startRect.x, startRect.y, textColor);
+    // The overlay shares the menu's flush, so only its queueing is its own
+    if (hudVisible()) {
+        Uint64 hudStart = SDL_GetPerformanceCounter();
+        drawHud();
+        hudOverlayEnd(hudStart);
+    }
 
+    flushSpriteBatch(gRenderer);
+    // Background copy, clear and highlight plus the batch
+    hudCount(HudCounter::DRAW_CALLS, 3 + spriteBatchDrawCalls());
+    Uint64 presentStart = SDL_GetPerformanceCounter();
     SDL_RenderPresent(gRenderer);
-
-    TTF_CloseFont(largeFont);
+    if (dirtyRectsActive()) {
+        presentWholeWindow(gRenderer, gWindow);
+    }
+    hudPhaseEnd(HudPhase::PRESENT, presentStart);
 }
 
-// Function to reset the ball to its initial state
-void resetBall(bool leftPlayerServe) {
-    ball.r = BALL_RADIUS;
-    ball.angle = 0;
-
-    // Position the ball at the middle of the screen
-    ball.x = SCREEN_WIDTH / 2 - ball.r;
-    ball.y = SCREEN_HEIGHT / 2;
-
-    // Calculate the velocity of the ball towards the middle goal
-    if (leftPlayerServe) {
-        ball.dx = BALL_SPEED_X; // Ball moves towards the right
+// Functions to draw with the SDL renderer, or into rasterTarget while a frame is rendered offline
+void sceneColor(Uint8 r, Uint8 g, Uint8 b, Uint8 a) {
+    if (rasterTarget != nullptr) {
+        rasterSetColor(*rasterTarget, r, g, b, a);
     }
     else {
-        ball.dx = -BALL_SPEED_X; // Ball moves towards the left
+        SDL_SetRenderDrawColor(gRenderer, r, g, b, a);
     }
-    ball.dy = 0; // Ball moves straight (no vertical component)
-    // Play the goal sound and delay for one second
-    SDL_Delay(1000);
 }
 
-
-
-
-// Function to handle menu input events
-void handleMenuInput(SDL_Event& e, bool& inMenu, bool& leftPlayerServe) {
-    if (e.type == SDL_KEYDOWN) {
-        switch (e.key.keysym.sym) {
-        case SDLK_UP:
-            selectedOption = (selectedOption == MenuOption::START) ? MenuOption::QUIT : MenuOption::START;
-            renderMenu();
-            break;
-        case SDLK_DOWN:
-            selectedOption = (selectedOption == MenuOption::START) ? MenuOption::QUIT : MenuOption::START;
-            renderMenu();
-            break;
-        case SDLK_RETURN:
-            if (selectedOption == MenuOption::START) {
-                inMenu = false; // Exit the menu loop
-                // Initialize game variables here
-                resetBall(leftPlayerServe);
-                leftScore = 0;
-                rightScore = 0;
-            }
-            else if (selectedOption == MenuOption::QUIT) {
-                close();
-                exit(0);
-            }
-            break;
-        default:
-            break;
-        }
+void sceneClear() {
+    if (rasterTarget != nullptr) {
+        rasterClear(*rasterTarget);
+    }
+    else {
+        SDL_RenderClear(gRenderer);
+        hudCount(HudCounter::DRAW_CALLS);
     }
 }
 
-
-// Function to check collision between two rectangles
-bool checkCollision(const SDL_Rect& rectA, const SDL_Rect& rectB) {
-    return (rectA.x + rectA.w >= rectB.x && rectB.x + rectB.w >= rectA.x && rectA.y + rectA.h >= rectB.y && rectB.y + rectB.h >= rectA.y);
-}
-
-// Function to update game state
-void update() {
-    // Update ball position
-    ball.x += ball.dx;
-    ball.y += ball.dy;
-
-    // Define ballRect for collision detection
-    SDL_Rect ballRect = { static_cast<int>(ball.x), static_cast<int>(ball.y), 2 * ball.r, 2 * ball.r };
-
-    // Handle ball collisions with top and bottom borders
-    if (ball.y <= 0 || ball.y + ball.r * 2 >= SCREEN_HEIGHT) {
-        Mix_PlayChannel(-1, wallSound, 0);
-        ball.dy = -ball.dy;
+void sceneFillRect(const SDL_Rect& rect) {
+    if (rasterTarget != nullptr) {
+        rasterFillRect(*rasterTarget, rect);
     }
-    // Handle ball collisions with left and right walls (sides)
-    if (ball.x <= 0 || ball.x + ball.r * 2 >= SCREEN_WIDTH) {
-        Mix_PlayChannel(-1, wallSound, 0);
-        ball.dx = -ball.dx;
+    else {
+        SDL_RenderFillRect(gRenderer, &rect);
+        hudCount(HudCounter::DRAW_CALLS);
     }
+}
 
-    // Handle ball collisions with left and right walls (goals)
-    if (ball.x <= leftGoal.x + leftGoal.w) {
-        if (ball.y + ball.r >= leftGoal.y && ball.y <= leftGoal.y + leftGoal.h) {
-            Mix_PlayChannel(-1, goalSound, 0);
-            ++rightScore;
-            resetBall(false); // Pass false to indicate right player serves next
-        }
+void sceneDrawRect(const SDL_Rect& rect) {
+    if (rasterTarget != nullptr) {
+        rasterDrawRect(*rasterTarget, rect);
     }
-    else if (ball.x + ball.r * 2 >= rightGoal.x) {
-        if (ball.y + ball.r >= rightGoal.y && ball.y <= rightGoal.y + rightGoal.h) {
-            Mix_PlayChannel(-1, goalSound, 0);
-            ++leftScore;
-            resetBall(true); // Pass true to indicate left player serves next
-        }
+    else {
+        SDL_RenderDrawRect(gRenderer, &rect);
+        hudCount(HudCounter::DRAW_CALLS);
     }
+}
 
-    // Define paddle areas for collision detection
-    SDL_Rect leftPaddleTop = { leftPaddle.x, leftPaddle.y, leftPaddle.w, leftPaddle.h / 3 };
-    SDL_Rect leftPaddleMiddle = { leftPaddle.x, leftPaddle.y + leftPaddle.h / 3, leftPaddle.w, leftPaddle.h / 3 };
-    SDL_Rect leftPaddleBottom = { leftPaddle.x, leftPaddle.y + 2 * leftPaddle.h / 3, leftPaddle.w, leftPaddle.h / 3 };
-    SDL_Rect rightPaddleTop = { rightPaddle.x, rightPaddle.y, rightPaddle.w, rightPaddle.h / 3 };
-    SDL_Rect rightPaddleMiddle = { rightPaddle.x, rightPaddle.y + rightPaddle.h / 3, rightPaddle.w, rightPaddle.h / 3 };
-    SDL_Rect rightPaddleBottom = { rightPaddle.x, rightPaddle.y + 2 * rightPaddle.h / 3, rightPaddle.w, rightPaddle.h / 3 };
-
-    // Check for collision with left paddle
-    if (checkCollision(ballRect, leftPaddleTop)) {
-        Mix_PlayChannel(-1, paddleSound, 0);
-        ball.dx = -ball.dx;
-        ball.dy = -BALL_SPEED_Y; // Ball moves upward
+void sceneDrawLine(int x1, int y1, int x2, int y2) {
+    if (rasterTarget != nullptr) {
+        rasterDrawLine(*rasterTarget, x1, y1, x2, y2);
     }
-    else if (checkCollision(ballRect, leftPaddleMiddle)) {
-        Mix_PlayChannel(-1, paddleSound, 0);
-        ball.dx = -ball.dx;
-        ball.dy = 0; // Ball moves straight
-    }
-    else if (checkCollision(ballRect, leftPaddleBottom)) {
-        Mix_PlayChannel(-1, paddleSound, 0);
-        ball.dx = -ball.dx;
-        ball.dy = BALL_SPEED_Y; // Ball moves downward
+    else {
+        SDL_RenderDrawLine(gRenderer, x1, y1, x2, y2);
+        hudCount(HudCounter::DRAW_CALLS);
     }
+}
 
-    // Check for collision with right paddle
-    if (checkCollision(ballRect, rightPaddleTop)) {
-        Mix_PlayChannel(-1, paddleSound, 0);
-        ball.dx = -ball.dx;
-        ball.dy = -BALL_SPEED_Y; // Ball moves upward
-    }
-    else if (checkCollision(ballRect, rightPaddleMiddle)) {
-        Mix_PlayChannel(-1, paddleSound, 0);
-        ball.dx = -ball.dx;
-        ball.dy = 0; // Ball moves straight
+void sceneDrawPoint(int x, int y) {
+    if (rasterTarget != nullptr) {
+        rasterDrawPoint(*rasterTarget, x, y);
     }
-    else if (checkCollision(ballRect, rightPaddleBottom)) {
-        Mix_PlayChannel(-1, paddleSound, 0);
-        ball.dx = -ball.dx;
-        ball.dy = BALL_SPEED_Y; // Ball moves downward
+    else {
+        SDL_RenderDrawPoint(gRenderer, x, y);
+        hudCount(HudCounter::DRAW_CALLS);
     }
+}
 
-    // Increment ball angle for rotation effect
-    ball.angle += 0.1;
+// Function to render the particle trail around the ball
+void renderParticles() {
+    int numParticles = 20;
+    hudCount(HudCounter::PARTICLES, numParticles);
+    for (int i = 0; i < numParticles; ++i) {
+        int radius = rand() % 10 + 5;
+        int offsetX = rand() % (2 * radius) - radius;
+        int offsetY = rand() % (2 * radius) - radius;
+        Uint8 red = 255;
+        Uint8 green = rand() % 256;
+        Uint8 blue = 0;
+        Uint8 alpha = rand() % 256;
+        sceneColor(red, green, blue, alpha);
+        SDL_Rect particleRect = { drawnState->ball.x + offsetX, drawnState->ball.y + offsetY, radius * 2, radius * 2 };
+        sceneFillRect(particleRect);
+    }
 }
 
+// Function to render the ball with its particle trail
+void renderBall() {
+    renderParticles();
 
+    // Render ball
+    sceneColor(255, 128, 0, 255);
+    int centerX = drawnState->ball.x + drawnState->ball.r;
+    int centerY = drawnState->ball.y + drawnState->ball.r;
+    for (int i = 0; i < 360; i += 30) {
+        float angle = (drawnState->ball.angle + i) * M_PI / 180.0;
+        int endX = centerX + drawnState->ball.r * std::cos(angle);
+        int endY = centerY + drawnState->ball.r * std::sin(angle);
+        sceneDrawLine(centerX, centerY, endX, endY);
+    }
+}
 
+// Function to get the area renderBall() can draw into: particles reach up to 14 px before
+// the ball's corner and up to 41 px past it, the spokes up to 2r past it
+SDL_Rect ballBounds() {
+    int reach = 2 * drawnState->ball.r > 41 ? 2 * drawnState->ball.r : 41;
+    int size = 15 + reach + 2;
+    return { static_cast<int>(drawnState->ball.x) - 15, static_cast<int>(drawnState->ball.y) - 15, size, size };
+}
 
-// Function to render the game scene
-void render() {
-    SDL_SetRenderDrawColor(gRenderer, 0, 128, 0, 255);
-    SDL_RenderClear(gRenderer);
+// Function to render the centre circle point by point
+void renderCenterCircle() {
+    int circleCenterX = SCREEN_WIDTH / 2;
+    int circleCenterY = SCREEN_HEIGHT / 2;
+    int radius = tuning.circleRadius;
+    int density = 1;
+    for (int i = 0; i < 360; i += density) {
+        float angle = i * M_PI / 180.0;
+        int x = circleCenterX + radius * std::cos(angle);
+        int y = circleCenterY + radius * std::sin(angle);
+        sceneDrawPoint(x, y);
+    }
+}
+
+// Function to render the pitch markings, everything that never moves
+void renderField() {
+    sceneColor(0, 128, 0, 255);
+    sceneClear();
 
     // Render borders
-    SDL_SetRenderDrawColor(gRenderer, 255, 255, 255, 255);
+    sceneColor(255, 255, 255, 255);
     SDL_Rect topBorder = { 0, 0, SCREEN_WIDTH, 10 };
     SDL_Rect bottomBorder = { 0, SCREEN_HEIGHT - 10, SCREEN_WIDTH, 10 };
     SDL_Rect leftBorder = { 0, 0, 10, SCREEN_HEIGHT };
     SDL_Rect rightBorder = { SCREEN_WIDTH - 10, 0, 10, SCREEN_HEIGHT };
-    SDL_RenderFillRect(gRenderer, &topBorder);
-    SDL_RenderFillRect(gRenderer, &bottomBorder);
-    SDL_RenderFillRect(gRenderer, &leftBorder);
-    SDL_RenderFillRect(gRenderer, &rightBorder);
+    sceneFillRect(topBorder);
+    sceneFillRect(bottomBorder);
+    sceneFillRect(leftBorder);
+    sceneFillRect(rightBorder);
 
     // Render goals
-    SDL_SetRenderDrawColor(gRenderer, 255, 0, 0, 255);
-    SDL_RenderFillRect(gRenderer, &leftGoal);
-    SDL_RenderFillRect(gRenderer, &rightGoal);
+    sceneColor(255, 0, 0, 255);
+    sceneFillRect(leftGoal);
+    sceneFillRect(rightGoal);
 
     // Render center spot
-    SDL_SetRenderDrawColor(gRenderer, 255, 255, 255, 255);
+    sceneColor(255, 255, 255, 255);
     SDL_Rect centerSpot = { SCREEN_WIDTH / 2 - 5, SCREEN_HEIGHT / 2 - 5, 10, 10 };
-    SDL_RenderFillRect(gRenderer, &centerSpot);
+    sceneFillRect(centerSpot);
 
     // Render halfway line
     SDL_Rect halfwayLine = { SCREEN_WIDTH / 2 - 1, 0, 2, SCREEN_HEIGHT };
-    SDL_RenderFillRect(gRenderer, &halfwayLine);
+    sceneFillRect(halfwayLine);
 
     // Render penalty areas
     SDL_Rect leftPenaltyArea = { 0, SCREEN_HEIGHT / 4, 150, SCREEN_HEIGHT / 2 };
     SDL_Rect rightPenaltyArea = { SCREEN_WIDTH - 150, SCREEN_HEIGHT / 4, 150, SCREEN_HEIGHT / 2 };
-    SDL_RenderDrawRect(gRenderer, &leftPenaltyArea);
-    SDL_RenderDrawRect(gRenderer, &rightPenaltyArea);
+    sceneDrawRect(leftPenaltyArea);
+    sceneDrawRect(rightPenaltyArea);
 
     // Render circle
-    int circleCenterX = SCREEN_WIDTH / 2;
-    int circleCenterY = SCREEN_HEIGHT / 2;
-    int radius = 80;
-    int density = 1;
-    for (int i = 0; i < 360; i += density) {
-        float angle = i * M_PI / 180.0;
-        int x = circleCenterX + radius * std::cos(angle);
-        int y = circleCenterY + radius * std::sin(angle);
-        SDL_RenderDrawPoint(gRenderer, x, y);
+    renderCenterCircle();
+}
+
+// Function to get the text shown over the field for the current stage of the game flow, nullptr for none
+const char* flowBanner() {
+    int value = 0;
+    switch (flowPhase(value)) {
+    case FlowPhase::COUNTDOWN:
+        return frameFormat("%d", value);
+    case FlowPhase::GOAL:
+        return value == 0 ? "Left scores!" : "Right scores!";
+    case FlowPhase::MATCH_END:
+        return value == 0 ? "Left player wins!" : "Right player wins!";
+    default:
+        return nullptr;
     }
+}
 
-    // Render paddles
-    SDL_SetRenderDrawColor(gRenderer, 255, 255, 255, 255);
-    SDL_Rect leftPaddleRect = { leftPaddle.x, leftPaddle.y, leftPaddle.w, leftPaddle.h };
-    SDL_Rect rightPaddleRect = { rightPaddle.x, rightPaddle.y, rightPaddle.w, rightPaddle.h };
-    SDL_RenderFillRect(gRenderer, &leftPaddleRect);
-    SDL_RenderFillRect(gRenderer, &rightPaddleRect);
+// Function to get where the banner goes: centred, a third of the way down
+SDL_Rect flowBannerBounds(const char* banner) {
+    int width = atlasTextWidth(AtlasFont::MENU, banner);
+    return { (SCREEN_WIDTH - width) / 2, SCREEN_HEIGHT / 3, width, atlasTextHeight(AtlasFont::MENU) };
+}
 
-    // Render particles
-    int numParticles = 20;
-    for (int i = 0; i < numParticles; ++i) {
-        int radius = rand() % 10 + 5;
-        int offsetX = rand() % (2 * radius) - radius;
-        int offsetY = rand() % (2 * radius) - radius;
-        Uint8 red = 255;
-        Uint8 green = rand() % 256;
-        Uint8 blue = 0;
-        Uint8 alpha = rand() % 256;
-        SDL_SetRenderDrawColor(gRenderer, red, green, blue, alpha);
-        SDL_Rect particleRect = { ball.x + offsetX, ball.y + offsetY, radius * 2, radius * 2 };
-        SDL_RenderFillRect(gRenderer, &particleRect);
+// Function to draw everything that moves: paddles, ball, scores, the flow banner and the replay bar
+void drawScene() {
+    // Render paddles
+    sceneColor(255, 255, 255, 255);
+    SDL_Rect leftPaddleRect = { drawnState->leftPaddle.x, drawnState->leftPaddle.y, drawnState->leftPaddle.w, drawnState->leftPaddle.h };
+    SDL_Rect rightPaddleRect = { drawnState->rightPaddle.x, drawnState->rightPaddle.y, drawnState->rightPaddle.w, drawnState->rightPaddle.h };
+    sceneFillRect(leftPaddleRect);
+    sceneFillRect(rightPaddleRect);
+
+    // Render the ball, or every arena ball in multiball mode
+    if (arenaActive) {
+        drawArena(arena);
     }
-
-    // Render ball
-    SDL_SetRenderDrawColor(gRenderer, 255, 128, 0, 255);
-    int centerX = ball.x + ball.r;
-    int centerY = ball.y + ball.r;
-    for (int i = 0; i < 360; i += 30) {
-        float angle = (ball.angle + i) * M_PI / 180.0;
-        int endX = centerX + ball.r * std::cos(angle);
-        int endY = centerY + ball.r * std::sin(angle);
-        SDL_RenderDrawLine(gRenderer, centerX, centerY, endX, endY);
+    else {
+        renderBall();
     }
 
     // Render scores
     SDL_Color textColor = { 255, 255, 255, 255 };
-    TTF_Font* largeFont = TTF_OpenFont("score.ttf", 48); // Larger font size for scores
-    if (largeFont == nullptr) {
-        std::cerr << "Failed to load font! SDL_ttf Error: " << TTF_GetError() << std::endl;
+    const char* leftScoreString = frameFormat("%d", drawnState->leftScore);
+    const char* rightScoreString = frameFormat("%d", drawnState->rightScore);
+    int rightScoreWidth = atlasTextWidth(AtlasFont::SCORE, rightScoreString);
+    batchText(AtlasFont::SCORE, leftScoreString, 50, 50, textColor);
+    batchText(AtlasFont::SCORE, rightScoreString, SCREEN_WIDTH - 50 - rightScoreWidth, 50, textColor);
+    const char* banner = flowBanner();
+    if (banner != nullptr) {
+        SDL_Rect bannerRect = flowBannerBounds(banner);
+        batchText(AtlasFont::MENU, banner, bannerRect.x, bannerRect.y, textColor);
+    }
+    // Replay position along the bottom edge
+    if (replayPlayback && replayReader.totalTicks > 0) {
+        SDL_Rect progress = { 0, SCREEN_HEIGHT - 4, static_cast<int>(static_cast<Uint64>(SCREEN_WIDTH) * replayReader.tick / replayReader.totalTicks), 4 };
+        batchFillRect(progress, { 255, 255, 0, 255 });
+    }
+}
+
+// Function to render the game scene
+void render() {
+    TRACE_SCOPE("render");
+    if (dirtyRectsActive()) {
+        // Put the cached field back wherever something moves this frame or moved away last frame
+        if (needsBackground()) {
+            renderField();
+            captureBackground(gRenderer);
+        }
+        if (arenaActive) {
+            markDirty({ 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT });
+        }
+        else {
+            markDirty(ballBounds());
+        }
+        markDirty({ drawnState->leftPaddle.x, drawnState->leftPaddle.y, drawnState->leftPaddle.w, drawnState->leftPaddle.h });
+        markDirty({ drawnState->rightPaddle.x, drawnState->rightPaddle.y, drawnState->rightPaddle.w, drawnState->rightPaddle.h });
+        int leftScoreWidth = atlasTextWidth(AtlasFont::SCORE, frameFormat("%d", drawnState->leftScore));
+        int rightScoreWidth = atlasTextWidth(AtlasFont::SCORE, frameFormat("%d", drawnState->rightScore));
+        int scoreHeight = atlasTextHeight(AtlasFont::SCORE);
+        markDirty({ 50, 50, leftScoreWidth, scoreHeight });
+        markDirty({ SCREEN_WIDTH - 50 - rightScoreWidth, 50, rightScoreWidth, scoreHeight });
+        if (replayPlayback) {
+            markDirty({ 0, SCREEN_HEIGHT - 4, SCREEN_WIDTH, 4 });
+        }
+        const char* banner = flowBanner();
+        if (banner != nullptr) {
+            markDirty(flowBannerBounds(banner));
+        }
+        if (hudVisible()) {
+            markDirty(hudBounds());
+        }
+        restoreDirtyRects(gRenderer);
+    }
+    else {
+        beginScaledFrame(gRenderer);
+        renderField();
+    }
+
+    drawScene();
+    flushSpriteBatch(gRenderer);
+    hudCount(HudCounter::DRAW_CALLS, spriteBatchDrawCalls());
+    endScaledFrame(gRenderer);
+    captureFrame(gRenderer, SDL_GetTicks());
+
+    // The overlay goes on after the capture and at native resolution
+    if (hudVisible()) {
+        Uint64 hudStart = SDL_GetPerformanceCounter();
+        drawHud();
+        flushSpriteBatch(gRenderer);
+        hudCount(HudCounter::DRAW_CALLS, spriteBatchDrawCalls());
+        hudOverlayEnd(hudStart);
+    }
+
+    latencyMark(LatencyStage::RENDER);
+    {
+        TRACE_SCOPE("present");
+        Uint64 presentStart = SDL_GetPerformanceCounter();
+        if (dirtyRectsActive()) {
+            presentDirtyRects(gRenderer, gWindow);
+        }
+        else {
+            SDL_RenderPresent(gRenderer);
+        }
+        hudPhaseEnd(HudPhase::PRESENT, presentStart);
+    }
+    latencyMark(LatencyStage::PRESENT);
+}
+
+// Function to draw the current scene into an offline frame with the tile rasterizer
+void renderOffline(RasterFrame& frame) {
+    rasterTarget = &frame;
+    renderField();
+    drawScene();
+    flushSpriteBatchToRaster(frame);
+    rasterTarget = nullptr;
+    rasterizeFrame(frame);
+}
+
+// Function to run --raster-bench and --raster-export on the scene as it stands, returns false if anything failed
+bool runRasterTasks() {
+    bool ok = true;
+    RasterFrame frame;
+    startRasterThreads(rasterThreads);
+    if (rasterBenchFrames > 0) {
+        // The same scene (particles included) through SDL and through the rasterizer must match at native size
+        initRasterFrame(frame, SCREEN_WIDTH, SCREEN_HEIGHT);
+        srand(1);
+        renderField();
+        drawScene();
+        flushSpriteBatch(gRenderer);
+        srand(1);
+        renderOffline(frame);
+        int different = compareRasterFrame(frame, gRenderer);
+        std::cout << "Rasterizer vs SDL renderer at " << SCREEN_WIDTH << "x" << SCREEN_HEIGHT << ": " << different
+            << " pixels differ" << std::endl;
+        ok = different == 0;
+
+        initRasterFrame(frame, rasterBenchWidth, rasterBenchHeight);
+        Uint64 start = SDL_GetPerformanceCounter();
+        for (int i = 0; i < rasterBenchFrames; ++i) {
+            resetFrameArena();
+            renderOffline(frame);
+        }
+        double seconds = static_cast<double>(SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+        std::cout << "Rasterized " << rasterBenchFrames << " frames at " << rasterBenchWidth << "x" << rasterBenchHeight
+            << " on " << rasterThreadCount() << " threads: " << rasterBenchFrames / seconds << " frames/s, "
+            << 1000.0 * seconds / rasterBenchFrames << " ms per frame" << std::endl;
+    }
+    if (rasterExportPath != nullptr) {
+        initRasterFrame(frame, rasterExportWidth, rasterExportHeight);
+        renderOffline(frame);
+        ok = saveRasterFrame(frame, rasterExportPath) && ok;
+    }
+    stopRasterThreads();
+    return ok;
+}
+
+
+// Function to register the --bench suite: the simulation functions, then the render paths on the headless
+// software renderer. Drawing is flushed inside the loop so SDL's command batching doesn't hide the cost.
+void registerMicrobenchmarks() {
+    registerBenchmark("BM_checkCollision", [](Uint64 iterations) {
+        static const SDL_Rect rects[4] = { { 10, 250, 20, 100 }, { 25, 300, 20, 20 }, { 400, 300, 20, 20 }, { 770, 250, 20, 100 } };
+        int hits = 0;
+        for (Uint64 i = 0; i < iterations; ++i) {
+            hits += checkCollision(rects[i & 3], rects[(i >> 2) & 3]) ? 1 : 0;
+        }
+        benchKeep(hits);
+    });
+    registerBenchmark("BM_update", [](Uint64 iterations) {
+        for (Uint64 i = 0; i < iterations; ++i) {
+            update();
+        }
+        benchKeep(ball);
+    });
+    registerBenchmark("BM_movePaddle", [](Uint64 iterations) {
+        for (Uint64 i = 0; i < iterations; ++i) {
+            movePaddle(leftPaddle, (i & 64) == 0, (i & 64) != 0);
+        }
+        benchKeep(leftPaddle);
+    });
+    registerBenchmark("BM_renderScoreText", [](Uint64 iterations) {
+        SDL_Color textColor = { 255, 255, 255, 255 };
+        for (Uint64 i = 0; i < iterations; ++i) {
+            resetFrameArena();
+            const char* leftScoreString = frameFormat("%d", static_cast<int>(i % 100));
+            const char* rightScoreString = frameFormat("%d", static_cast<int>(i % 37));
+            int rightScoreWidth = atlasTextWidth(AtlasFont::SCORE, rightScoreString);
+            batchText(AtlasFont::SCORE, leftScoreString, 50, 50, textColor);
+            batchText(AtlasFont::SCORE, rightScoreString, SCREEN_WIDTH - 50 - rightScoreWidth, 50, textColor);
+            flushSpriteBatch(gRenderer);
+            SDL_RenderFlush(gRenderer);
+        }
+    });
+    registerBenchmark("BM_renderMenu", [](Uint64 iterations) {
+        for (Uint64 i = 0; i < iterations; ++i) {
+            renderMenu();
+        }
+    });
+    registerBenchmark("BM_renderParticles", [](Uint64 iterations) {
+        for (Uint64 i = 0; i < iterations; ++i) {
+            renderParticles();
+            SDL_RenderFlush(gRenderer);
+        }
+    });
+    registerBenchmark("BM_renderCenterCircle", [](Uint64 iterations) {
+        sceneColor(255, 255, 255, 255);
+        for (Uint64 i = 0; i < iterations; ++i) {
+            renderCenterCircle();
+            SDL_RenderFlush(gRenderer);
+        }
+    });
+    registerBenchmark("BM_render", [](Uint64 iterations) {
+        for (Uint64 i = 0; i < iterations; ++i) {
+            resetFrameArena();
+            render();
+        }
+    });
+}
+
+// Function to handle game input for one simulation tick
+void handleGameInput(const PaddleInput& input) {
+    PaddleInput controls = input;
+    if (leftAi.enabled) {
+        aiDecide(leftAi, ball, leftPaddle, true, controls.leftUp, controls.leftDown);
+    }
+    if (rightAi.enabled) {
+        aiDecide(rightAi, ball, rightPaddle, false, controls.rightUp, controls.rightDown);
+    }
+
+    // Recorded after the AI so playback needs neither the AI nor its settings, and before the move
+    // so keyframes hold the state the tick starts from
+    recordReplayTick(replayWriter, packReplayInput(controls.leftUp, controls.leftDown, controls.rightUp, controls.rightDown));
+
+    if (input.leftUp || input.leftDown) {
+        latencyMark(LatencyStage::INPUT);
+    }
+    movePaddle(leftPaddle, controls.leftUp, controls.leftDown);
+    if (input.leftUp || input.leftDown) {
+        latencyMark(LatencyStage::MOVE);
+    }
+    movePaddle(rightPaddle, controls.rightUp, controls.rightDown);
+}
+
+// Function to start recording from the current game state if --record was given
+void startRecordingIfRequested() {
+    if (recordPath != nullptr && !netplayActive && !replayPlayback) {
+        startReplayRecording(replayWriter, recordPath);
+    }
+}
+
+// Function to advance the game by one fixed tick
+void runGameTick(const PaddleInput& input, bool& leftPlayerServe) {
+    // Over the network either key pair drives this side's paddle, the rollback session runs update()
+    if (netplayActive) {
+        bool up = input.leftUp || input.rightUp;
+        bool down = input.leftDown || input.rightDown;
+        advanceSession(netSession, (up ? NET_INPUT_UP : 0) | (down ? NET_INPUT_DOWN : 0));
         return;
     }
-    std::stringstream leftScoreStream;
-    leftScoreStream << leftScore;
-    std::string leftScoreString = leftScoreStream.str();
-    std::stringstream rightScoreStream;
-    rightScoreStream << rightScore;
-    std::string rightScoreString = rightScoreStream.str();
-    SDL_Surface* leftScoreSurface = TTF_RenderText_Solid(largeFont, leftScoreString.c_str(), textColor);
-    SDL_Surface* rightScoreSurface = TTF_RenderText_Solid(largeFont, rightScoreString.c_str(), textColor);
-    SDL_Texture* leftScoreTexture = SDL_CreateTextureFromSurface(gRenderer, leftScoreSurface);
-    SDL_Texture* rightScoreTexture = SDL_CreateTextureFromSurface(gRenderer, rightScoreSurface);
-    SDL_Rect leftScoreRect = { 50, 50, leftScoreSurface->w, leftScoreSurface->h };
-    SDL_Rect rightScoreRect = { SCREEN_WIDTH - 50 - rightScoreSurface->w, 50, rightScoreSurface->w, rightScoreSurface->h };
-    SDL_RenderCopy(gRenderer, leftScoreTexture, NULL, &leftScoreRect);
-    SDL_RenderCopy(gRenderer, rightScoreTexture, NULL, &rightScoreRect);
-    SDL_FreeSurface(leftScoreSurface);
-    SDL_FreeSurface(rightScoreSurface);
-    SDL_DestroyTexture(leftScoreTexture);
-    SDL_DestroyTexture(rightScoreTexture);
-    TTF_CloseFont(largeFont);
 
-    SDL_RenderPresent(gRenderer);
+    handleGameInput(input);
+    // The arena scores its own goals and serves balls without pausing
+    if (arenaActive) {
+        updateArena(arena);
+        latencyMark(LatencyStage::UPDATE);
+        return;
+    }
+    update();
+    latencyMark(LatencyStage::UPDATE);
+
+    // Check for goal
+    if (ball.x <= leftGoal.x + leftGoal.w) {
+        if (ball.y + ball.r >= leftGoal.y && ball.y <= leftGoal.y + leftGoal.h) {
+            ++rightScore;
+            leftPlayerServe = false; // Right player serves next
+            resetBall(leftPlayerServe);
+        }
+    }
+    else if (ball.x + ball.r * 2 >= rightGoal.x) {
+        if (ball.y + ball.r >= rightGoal.y && ball.y <= rightGoal.y + rightGoal.h) {
+            ++leftScore;
+            leftPlayerServe = true; // Left player serves next
+            resetBall(leftPlayerServe);
+        }
+    }
 }
 
+// Game flow stages. Each runs on the ticks (or events) the main loop or simulation thread hands the
+// flow, so nothing between the menu and the match end blocks or allocates.
 
-// Function to move the paddle based on input
-void movePaddle(Paddle& paddle, bool up, bool down) {
-    if (up && paddle.y > 0) {
-        paddle.y -= 5;
+// Function for the menu: up/down move the selection, Enter picks it; yields 1 to play, 0 to quit
+FlowTask menuStage() {
+    setFlowPhase(FlowPhase::MENU);
+    while (true) {
+        SDL_Event e = co_await waitEvent(SDL_KEYDOWN);
+        switch (e.key.keysym.sym) {
+        case SDLK_UP:
+        case SDLK_DOWN:
+            selectedOption = (selectedOption == MenuOption::START) ? MenuOption::QUIT : MenuOption::START;
+            break;
+        case SDLK_RETURN:
+            co_return selectedOption == MenuOption::START ? 1 : 0;
+        default:
+            break;
+        }
     }
-    if (down && paddle.y < SCREEN_HEIGHT - paddle.h) {
-        paddle.y += 5;
+}
+
+// Function for the countdown before a serve: the field stays frozen, but input is still sampled
+// every tick so keys pressed during it don't pile up for the first tick of the rally
+FlowTask serveCountdownStage() {
+    for (int seconds = SERVE_COUNTDOWN_SECONDS; seconds > 0; --seconds) {
+        setFlowPhase(FlowPhase::COUNTDOWN, seconds);
+        for (int tick = 0; tick < TICKS_PER_SECOND; ++tick) {
+            co_await waitTicks(1);
+            sampleTickInput(flowTickEnd());
+        }
+    }
+    co_return 0;
+}
+
+// Function for a rally: play ticks until someone scores; yields 0 if the left player did, 1 for the right
+FlowTask rallyStage() {
+    setFlowPhase(FlowPhase::RALLY);
+    int leftBefore = leftScore;
+    int rightBefore = rightScore;
+    while (leftScore == leftBefore && rightScore == rightBefore) {
+        co_await waitTicks(1);
+        runGameTick(sampleTickInput(flowTickEnd()), gameState.leftPlayerServe);
+    }
+    co_return rightScore != rightBefore ? 1 : 0;
+}
+
+// Function to show who scored before the next serve
+FlowTask goalStage(int side) {
+    setFlowPhase(FlowPhase::GOAL, side);
+    co_await waitTicks(GOAL_CELEBRATION_TICKS);
+    co_return side;
+}
+
+// Function to show the winner before going back to the menu
+FlowTask matchEndStage(int winner) {
+    setFlowPhase(FlowPhase::MATCH_END, winner);
+    co_await waitTicks(MATCH_END_TICKS);
+    co_return winner;
+}
+
+// Function for a match: serves and rallies until a side reaches matchPoints; yields the winner.
+// Every arena ball scores, so a few points would be over within ticks: the arena plays on instead.
+FlowTask matchStage() {
+    leftScore = 0;
+    rightScore = 0;
+    resetPaddles();
+    resetBall(gameState.leftPlayerServe);
+    if (arenaActive) {
+        // Same count as before, so the arrays are reused rather than reallocated
+        initArena(arena, arenaBalls, 1);
+    }
+
+    bool serve = true;
+    while (true) {
+        if (serve) {
+            co_await serveCountdownStage();
+        }
+        int scorer = co_await rallyStage();
+        if (matchPoints > 0 && !arenaActive && (leftScore >= matchPoints || rightScore >= matchPoints)) {
+            int winner = co_await matchEndStage(leftScore >= matchPoints ? 0 : 1);
+            co_return winner;
+        }
+        // The arena keeps its other balls in play, so it goes straight back to the rally
+        serve = !arenaActive;
+        if (serve) {
+            co_await goalStage(scorer);
+        }
+    }
+}
+
+// Function for the whole game: menu, then a match, until the player picks Quit
+FlowTask gameFlow() {
+    while (true) {
+        int choice = co_await menuStage();
+        if (choice == 0) {
+            co_return 0;
+        }
+        co_await matchStage();
+    }
+}
+
+// Function run on the simulation thread for every tick with --sim-thread
+void runThreadedTick(Uint32 tickEnd) {
+    tickFlow(tickEnd);
+    if (spectatorPort != 0) {
+        broadcastSnapshot(spectatorServer, spectatorTick++);
+    }
+}
+
+// Function to follow the game flow from the main loop: set up a match when it leaves the menu, put
+// things back when it returns there, and quit once it has finished
+void followGameFlow(bool& inMenu, bool& quit, Uint32& tickEnd) {
+    if (!gameFlowActive()) {
+        return;
+    }
+    FlowPhase phase = flowPhase();
+    if (phase == FlowPhase::DONE) {
+        quit = true;
+    }
+    else if (inMenu && phase != FlowPhase::MENU) {
+        // Match starts now, restart the tick clock
+        inMenu = false;
+        startRecordingIfRequested();
+        resetInput();
+        tickEnd = SDL_GetTicks() + TICK_MS;
+        if (simThreadRequested) {
+            startSimulationThread(runThreadedTick);
+        }
+    }
+    else if (!inMenu && phase == FlowPhase::MENU) {
+        // The game globals are the main thread's again, and a recording holds a single match
+        stopSimulationThread();
+        drawnState = &gameState;
+        finishReplayRecording(replayWriter);
+        recordPath = nullptr;
+        inMenu = true;
+        requestMenuRedraw();
+    }
+}
+
+// Function to run the next recorded ticks, returns false when the replay runs out
+bool runReplayTicks(int count, bool& leftPlayerServe) {
+    for (int i = 0; i < count; ++i) {
+        ReplayInput recorded;
+        if (!nextReplayInput(replayReader, recorded)) {
+            return false;
+        }
+        PaddleInput input;
+        unpackReplayInput(recorded, input.leftUp, input.leftDown, input.rightUp, input.rightDown);
+        runGameTick(input, leftPlayerServe);
     }
+    return true;
 }
 
-// Function to handle game input
-void handleGameInput(const Uint8* currentKeyStates) {
-    movePaddle(leftPaddle, currentKeyStates[SDL_SCANCODE_W], currentKeyStates[SDL_SCANCODE_S]);
-    movePaddle(rightPaddle, currentKeyStates[SDL_SCANCODE_UP], currentKeyStates[SDL_SCANCODE_DOWN]);
+// Function to jump to any tick: restore the nearest keyframe, then silently simulate the rest
+void seekPlayback(Uint32 tick, bool& leftPlayerServe) {
+    if (tick > replayReader.totalTicks) {
+        tick = replayReader.totalTicks;
+    }
+    void (*soundHandler)(GameSound) = gameSoundHandler;
+    Uint32 pauseMs = servePauseMs;
+    gameSoundHandler = silentGameSound;
+    servePauseMs = 0;
+
+    seekReplay(replayReader, tick);
+    runReplayTicks(static_cast<int>(tick - replayReader.tick), leftPlayerServe);
+
+    gameSoundHandler = soundHandler;
+    servePauseMs = pauseMs;
+}
+
+// Function to set the playback speed; the serve pause shrinks with it so fast-forward doesn't stall
+void setPlaybackSpeed(int speed) {
+    playbackSpeed = speed < 1 ? 1 : (speed > MAX_PLAYBACK_SPEED ? MAX_PLAYBACK_SPEED : speed);
+    servePauseMs = 1000 / playbackSpeed;
+}
+
+// Function to handle replay controls: space pauses, up/down change speed, left/right skip 10 seconds,
+// Home/End and 0-9 jump, and clicking or dragging across the window scrubs
+void handleReplayInput(const SDL_Event& e, bool& leftPlayerServe) {
+    const Uint32 skipTicks = 10000 / TICK_MS;
+    if (e.type == SDL_KEYDOWN) {
+        SDL_Keycode key = e.key.keysym.sym;
+        switch (key) {
+        case SDLK_SPACE:
+            playbackPaused = !playbackPaused;
+            break;
+        case SDLK_UP:
+            setPlaybackSpeed(playbackSpeed * 2);
+            break;
+        case SDLK_DOWN:
+            setPlaybackSpeed(playbackSpeed / 2);
+            break;
+        case SDLK_RIGHT:
+            seekPlayback(replayReader.tick + skipTicks, leftPlayerServe);
+            break;
+        case SDLK_LEFT:
+            seekPlayback(replayReader.tick > skipTicks ? replayReader.tick - skipTicks : 0, leftPlayerServe);
+            break;
+        case SDLK_HOME:
+            seekPlayback(0, leftPlayerServe);
+            break;
+        case SDLK_END:
+            seekPlayback(replayReader.totalTicks, leftPlayerServe);
+            break;
+        default:
+            if (key >= SDLK_0 && key <= SDLK_9) {
+                seekPlayback(static_cast<Uint32>(static_cast<Uint64>(replayReader.totalTicks) * (key - SDLK_0) / 10), leftPlayerServe);
+            }
+            break;
+        }
+    }
+    else if ((e.type == SDL_MOUSEBUTTONDOWN && e.button.button == SDL_BUTTON_LEFT) ||
+             (e.type == SDL_MOUSEMOTION && (e.motion.state & SDL_BUTTON_LMASK) != 0)) {
+        int x = e.type == SDL_MOUSEBUTTONDOWN ? e.button.x : e.motion.x;
+        x = x < 0 ? 0 : (x > SCREEN_WIDTH ? SCREEN_WIDTH : x);
+        seekPlayback(static_cast<Uint32>(static_cast<Uint64>(replayReader.totalTicks) * x / SCREEN_WIDTH), leftPlayerServe);
+    }
 }
 
 // Main function
 int main(int argc, char* args[]) {
     bool inMenu = true;
-    bool leftPlayerServe = true; // Variable to track which player serves
+    bool& leftPlayerServe = gameState.leftPlayerServe; // Variable to track which player serves
+    bool aiLeft = false;
+    bool aiRight = false;
+    int aiReactionTicks = 6;
+    float aiNoise = 20.0f;
+    Uint16 localPort = 0;
+    const char* peerHost = nullptr;
+    Uint16 peerPort = 0;
+    Uint32 replaySeekTick = 0;
+    int idleCheckSeconds = 0;
+    const char* spectateHost = nullptr;
+    Uint16 spectatePort = 0;
+    GameVariant variant = GameVariant::CLASSIC;
+
+    // Parse command line options
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(args[i], "--low-latency-audio") == 0) {
+            lowLatencyAudioFrames = 256;
+            if (i + 1 < argc && args[i + 1][0] != '-') {
+                lowLatencyAudioFrames = std::atoi(args[++i]);
+            }
+        }
+        else if (std::strcmp(args[i], "--latency-probe") == 0) {
+            int samples = 1000;
+            if (i + 1 < argc && args[i + 1][0] != '-') {
+                samples = std::atoi(args[++i]);
+            }
+            startLatencyProbe(samples);
+            headless = true;
+        }
+        else if (std::strcmp(args[i], "--idle-check") == 0) {
+            // Sit in the menu untouched and report how much CPU it burns
+            idleCheckSeconds = 10;
+            if (i + 1 < argc && args[i + 1][0] != '-') {
+                idleCheckSeconds = std::atoi(args[++i]);
+            }
+        }
+        else if (std::strcmp(args[i], "--alloc-check") == 0) {
+            // Headless AI match that fails if steady-state frames touch the heap
+            int frames = 10000;
+            if (i + 1 < argc && args[i + 1][0] != '-') {
+                frames = std::atoi(args[++i]);
+            }
+            startAllocationCheck(frames);
+            headless = true;
+            aiLeft = true;
+            aiRight = true;
+        }
+        else if (std::strcmp(args[i], "--frame-budget") == 0) {
+            // Render at a lower internal resolution whenever frames run over budget
+            frameBudgetMs = 12.0f;
+            if (i + 1 < argc && args[i + 1][0] != '-') {
+                frameBudgetMs = static_cast<float>(std::atof(args[++i]));
+            }
+        }
+        else if (std::strcmp(args[i], "--dirty-rects") == 0) {
+            dirtyRects = true;
+        }
+        else if (std::strcmp(args[i], "--capture") == 0 && i + 1 < argc) {
+            capturePath = args[++i];
+            if (i + 1 < argc && args[i + 1][0] != '-') {
+                captureFps = std::atoi(args[++i]);
+            }
+        }
+        else if (std::strcmp(args[i], "--bench") == 0) {
+            // Microbenchmarks on the headless renderer: [name filter]
+            benchFilter = "";
+            if (i + 1 < argc && args[i + 1][0] != '-') {
+                benchFilter = args[++i];
+            }
+            headless = true;
+        }
+        else if (std::strcmp(args[i], "--bench-json") == 0 && i + 1 < argc) {
+            benchJsonPath = args[++i];
+        }
+        else if (std::strcmp(args[i], "--raster-export") == 0 && i + 1 < argc) {
+            // Write the opening scene (or the --replay-seek position) to a BMP: path [width height]
+            rasterExportPath = args[++i];
+            if (i + 2 < argc && args[i + 1][0] != '-' && args[i + 2][0] != '-') {
+                rasterExportWidth = std::atoi(args[++i]);
+                rasterExportHeight = std::atoi(args[++i]);
+            }
+            headless = true;
+        }
+        else if (std::strcmp(args[i], "--raster-bench") == 0) {
+            // Offline rendering timing: [width] [height] [frames] [threads]
+            int settings[4] = { rasterBenchWidth, rasterBenchHeight, 1000, rasterThreads };
+            for (int j = 0; j < 4 && i + 1 < argc && args[i + 1][0] != '-'; ++j) {
+                settings[j] = std::atoi(args[++i]);
+            }
+            rasterBenchWidth = settings[0];
+            rasterBenchHeight = settings[1];
+            rasterBenchFrames = settings[2];
+            rasterThreads = settings[3];
+            headless = true;
+        }
+        else if (std::strcmp(args[i], "--hud") == 0) {
+            toggleHud();
+        }
+        else if (std::strcmp(args[i], "--trace") == 0 && i + 1 < argc) {
+            tracePath = args[++i];
+        }
+        else if (std::strcmp(args[i], "--sim-thread") == 0) {
+            simThreadRequested = true;
+        }
+        else if (std::strcmp(args[i], "--headless") == 0) {
+            headless = true;
+        }
+        else if (std::strcmp(args[i], "--match-points") == 0 && i + 1 < argc) {
+            matchPoints = std::atoi(args[++i]);
+        }
+        else if (std::strcmp(args[i], "--ai-left") == 0) {
+            aiLeft = true;
+        }
+        else if (std::strcmp(args[i], "--ai-right") == 0) {
+            aiRight = true;
+        }
+        else if (std::strcmp(args[i], "--ai-reaction") == 0 && i + 1 < argc) {
+            aiReactionTicks = std::atoi(args[++i]);
+        }
+        else if (std::strcmp(args[i], "--ai-noise") == 0 && i + 1 < argc) {
+            aiNoise = static_cast<float>(std::atof(args[++i]));
+        }
+        else if (std::strcmp(args[i], "--host") == 0 && i + 1 < argc) {
+            localPort = static_cast<Uint16>(std::atoi(args[++i]));
+            netplayActive = true;
+        }
+        else if (std::strcmp(args[i], "--join") == 0 && i + 1 < argc) {
+            // host:port
+            static char host[256];
+            std::strncpy(host, args[++i], sizeof(host) - 1);
+            char* colon = std::strrchr(host, ':');
+            if (colon == nullptr) {
+                std::cerr << "Expected --join host:port" << std::endl;
+                return -1;
+            }
+            *colon = '\0';
+            peerHost = host;
+            peerPort = static_cast<Uint16>(std::atoi(colon + 1));
+            netplayActive = true;
+        }
+        else if (std::strcmp(args[i], "--netplay-loopback") == 0) {
+            // Two rollback sessions in this process: [ticks] [rtt ms] [jitter ms] [loss %]
+            int settings[4] = { 30000, 150, 20, 5 };
+            for (int j = 0; j < 4 && i + 1 < argc && args[i + 1][0] != '-'; ++j) {
+                settings[j] = std::atoi(args[++i]);
+            }
+            return runLoopbackTest(settings[0], settings[1], settings[2], settings[3]) ? 0 : 1;
+        }
+        else if (std::strcmp(args[i], "--record") == 0 && i + 1 < argc) {
+            recordPath = args[++i];
+        }
+        else if (std::strcmp(args[i], "--play-replay") == 0 && i + 1 < argc) {
+            if (!openReplay(replayReader, args[++i])) {
+                return -1;
+            }
+            replayPlayback = true;
+        }
+        else if (std::strcmp(args[i], "--replay-speed") == 0 && i + 1 < argc) {
+            setPlaybackSpeed(std::atoi(args[++i]));
+        }
+        else if (std::strcmp(args[i], "--replay-seek") == 0 && i + 1 < argc) {
+            replaySeekTick = static_cast<Uint32>(std::atoi(args[++i]));
+        }
+        else if (std::strcmp(args[i], "--spectator-port") == 0 && i + 1 < argc) {
+            spectatorPort = static_cast<Uint16>(std::atoi(args[++i]));
+        }
+        else if (std::strcmp(args[i], "--spectate") == 0 && i + 1 < argc) {
+            // host:port
+            static char host[256];
+            std::strncpy(host, args[++i], sizeof(host) - 1);
+            char* colon = std::strrchr(host, ':');
+            if (colon == nullptr) {
+                std::cerr << "Expected --spectate host:port" << std::endl;
+                return -1;
+            }
+            *colon = '\0';
+            spectateHost = host;
+            spectatePort = static_cast<Uint16>(std::atoi(colon + 1));
+            spectating = true;
+        }
+        else if (std::strcmp(args[i], "--variant") == 0 && i + 1 < argc) {
+            if (!parseGameVariant(args[++i], variant)) {
+                std::cerr << "Unknown variant " << args[i] << ", expected classic, big-arena, training or runtime" << std::endl;
+                return -1;
+            }
+        }
+        else if (std::strcmp(args[i], "--tune") == 0 && i + 1 < argc) {
+            // Runtime-configured variant: name=value, one per --tune
+            if (!setRuntimeTuning(args[++i])) {
+                std::cerr << "Unknown tuning " << args[i] << std::endl;
+                return -1;
+            }
+            variant = GameVariant::RUNTIME;
+        }
+        else if (std::strcmp(args[i], "--multiball") == 0) {
+            int balls = ARENA_DEFAULT_BALLS;
+            if (i + 1 < argc && args[i + 1][0] != '-') {
+                balls = std::atoi(args[++i]);
+            }
+            arenaBalls = balls;
+            initArena(arena, arenaBalls, 1);
+            arenaActive = true;
+        }
+        else if (std::strcmp(args[i], "--arena-bench") == 0) {
+            // Headless arena timing: [balls] [ticks]
+            int settings[2] = { ARENA_DEFAULT_BALLS, 2000 };
+            for (int j = 0; j < 2 && i + 1 < argc && args[i + 1][0] != '-'; ++j) {
+                settings[j] = std::atoi(args[++i]);
+            }
+            runArenaBenchmark(settings[0], settings[1]);
+            return 0;
+        }
+        else if (std::strcmp(args[i], "--snapshot-bench") == 0) {
+            int count = 50000000;
+            if (i + 1 < argc && args[i + 1][0] != '-') {
+                count = std::atoi(args[++i]);
+            }
+            runSnapshotBenchmark(count);
+            return 0;
+        }
+        else if (std::strcmp(args[i], "--spectator-bench") == 0) {
+            // Headless match streamed to many local spectators: [spectators] [ticks] [port]
+            int settings[3] = { 1000, 6000, 27015 };
+            for (int j = 0; j < 3 && i + 1 < argc && args[i + 1][0] != '-'; ++j) {
+                settings[j] = std::atoi(args[++i]);
+            }
+            return runSpectatorBenchmark(settings[0], settings[1], static_cast<Uint16>(settings[2])) ? 0 : 1;
+        }
+    }
+    if (arenaActive && (netplayActive || replayPlayback || recordPath != nullptr)) {
+        std::cerr << "--multiball only runs locally, ignoring it" << std::endl;
+        arenaActive = false;
+    }
+    // Replays, network play and spectators assume the classic rules
+    if (variant != GameVariant::CLASSIC && (netplayActive || replayPlayback || recordPath != nullptr || spectatorPort != 0 || spectating)) {
+        std::cerr << "--variant only runs locally, ignoring it" << std::endl;
+        variant = GameVariant::CLASSIC;
+    }
+    // The threaded loop covers local play only; the other modes drive ticks from the main loop
+    if (simThreadRequested && (netplayActive || replayPlayback || spectating || arenaActive || latencyProbeActive() || allocationCheckActive())) {
+        std::cerr << "--sim-thread only runs local games, ignoring it" << std::endl;
+        simThreadRequested = false;
+    }
+    // The modes that skip the menu would measure the game instead
+    if (idleCheckSeconds > 0) {
+        if (netplayActive || replayPlayback || spectating || latencyProbeActive() || allocationCheckActive()) {
+            std::cerr << "--idle-check only runs in the local menu, ignoring it" << std::endl;
+        }
+        else {
+            startIdleCheck(idleCheckSeconds);
+        }
+    }
+    if (!selectGameVariant(variant)) {
+        std::cerr << "The --tune values don't fit the field" << std::endl;
+        return -1;
+    }
+    // Each side of a network match is played from its own keyboard
+    if (netplayActive && (aiLeft || aiRight)) {
+        std::cerr << "--ai-left/--ai-right are not supported in network play, ignoring them" << std::endl;
+        aiLeft = false;
+        aiRight = false;
+    }
+    if (recordPath != nullptr && netplayActive) {
+        std::cerr << "--record is not supported in network play, ignoring it" << std::endl;
+    }
+    // A replay already contains whatever the AI did
+    if (replayPlayback) {
+        aiLeft = false;
+        aiRight = false;
+    }
+    if (aiLeft) {
+        initAi(leftAi, aiReactionTicks, aiNoise, 1);
+    }
+    if (aiRight) {
+        initAi(rightAi, aiReactionTicks, aiNoise, 2);
+    }
+
+    if (allocationCheckActive()) {
+        installAllocationHooks();
+        servePauseMs = 0;
+    }
+
+    // Tracing starts before initialize() so the asset loads are on the timeline
+    if (tracePath != nullptr && !startTrace(tracePath)) {
+        return -1;
+    }
 
     if (!initialize()) {
         std::cerr << "Failed to initialize!" << std::endl;
@@ -491,54 +1327,286 @@ int main(int argc, char* args[]) {
         return -1;
     }
 
-    leftPaddle = { 20, SCREEN_HEIGHT / 2 - PADDLE_HEIGHT / 2, PADDLE_WIDTH, PADDLE_HEIGHT };
-    rightPaddle = { SCREEN_WIDTH - 20 - PADDLE_WIDTH, SCREEN_HEIGHT / 2 - PADDLE_HEIGHT / 2, PADDLE_WIDTH, PADDLE_HEIGHT };
+    if (dirtyRects && frameBudgetMs > 0.0f) {
+        // Partial presents need every frame at full size in the window surface
+        std::cout << "--frame-budget is ignored with --dirty-rects" << std::endl;
+        frameBudgetMs = 0.0f;
+    }
+    if (frameBudgetMs > 0.0f && !initDynamicResolution(gRenderer, frameBudgetMs)) {
+        close();
+        return -1;
+    }
+    if (capturePath != nullptr && !startCapture(capturePath, gRenderer, captureFps)) {
+        close();
+        return -1;
+    }
+
+    // Benchmarks run silently on the opening position with no serve pause, then exit
+    if (benchFilter != nullptr) {
+        servePauseMs = 0;
+        resetPaddles();
+        resetBall(true);
+        registerMicrobenchmarks();
+        bool benchmarked = runBenchmarks(benchFilter[0] != '\0' ? benchFilter : nullptr, benchJsonPath);
+        close();
+        return benchmarked ? 0 : 1;
+    }
+
+    resetPaddles();
+    gameSoundHandler = playGameSound;
 
     // Start the game with the ball positioned at the left player's goal
     resetBall(leftPlayerServe);
 
     SDL_Event e;
     bool quit = false;
+    Uint32 tickEnd = 0; // End time of the next simulation tick
+
+    bool networkUsed = netplayActive || spectatorPort != 0 || spectating;
+    if (networkUsed && !initializeNetwork()) {
+        close();
+        return -1;
+    }
+
+    // Network play starts as soon as the socket is up: host is the left paddle, the joining side the right
+    if (netplayActive) {
+        if (!netTransport.open(localPort, peerHost, peerPort)) {
+            close();
+            return -1;
+        }
+        startSession(netSession, peerHost == nullptr ? 0 : 1, &netTransport);
+    }
+
+    if ((spectatorPort != 0 && !openSpectatorServer(spectatorServer, spectatorPort)) ||
+        (spectating && !connectSpectator(spectatorClient, spectateHost, spectatePort))) {
+        close();
+        return -1;
+    }
+
+    // Playback starts from the state the recording started from
+    if (replayPlayback) {
+        loadSimState(replayReader.initialState);
+        if (replaySeekTick > 0) {
+            seekPlayback(replaySeekTick, leftPlayerServe);
+        }
+    }
+
+    // Offline rendering draws the scene as it stands (opening serve or replay position) and exits
+    if (rasterExportPath != nullptr || rasterBenchFrames > 0) {
+        bool rendered = runRasterTasks();
+        closeReplay(replayReader);
+        close();
+        return rendered ? 0 : 1;
+    }
+
+    // The probes, network play, replays and spectating skip the menu
+    if (latencyProbeActive() || allocationCheckActive() || netplayActive || replayPlayback || spectating) {
+        inMenu = false;
+        startRecordingIfRequested();
+        resetInput();
+        tickEnd = SDL_GetTicks() + TICK_MS;
+    }
+    else {
+        // Local games run through the game flow, where the serve pause is a countdown rather than a delay
+        servePauseMs = 0;
+        startGameFlow(gameFlow());
+    }
+
+    // Only a local game can stop while nobody is watching; headless runs never see their window
+    bool suspendWhenHidden = !netplayActive && spectatorPort == 0 && !spectating && !headless;
 
     while (!quit) {
-        while (SDL_PollEvent(&e) != 0) {
-            if (e.type == SDL_QUIT) {
-                quit = true;
-            }
-            if (inMenu) {
-                handleMenuInput(e, inMenu, leftPlayerServe); // Pass leftPlayerServe to handleMenuInput
+        // Scratch memory from the last frame is free again
+        resetFrameArena();
+        // Hand last frame's events to the trace file before this one's start
+        flushTrace();
+        TRACE_SCOPE("frame");
+        hudBeginFrame();
+        Uint64 phaseStart = SDL_GetPerformanceCounter();
+        // Before polling, so a match that ended on the simulation thread hands the game back first
+        followGameFlow(inMenu, quit, tickEnd);
+
+        if (latencyProbeActive() && !latencyProbeStep()) {
+            break;
+        }
+        if (idleCheckActive() && !idleCheckStep()) {
+            break;
+        }
+        if (allocationCheckActive()) {
+            if (!allocationCheckFrame()) {
+                break;
             }
+            // One tick per frame as fast as it will go
+            tickEnd = SDL_GetTicks();
         }
 
+        // Nothing moves in the menu, so sleep until there is input or something to animate
         if (inMenu) {
-            renderMenu();
+            TRACE_SCOPE("idle");
+            waitForMenuWake();
+            phaseStart = SDL_GetPerformanceCounter();
         }
-        else {
-            const Uint8* currentKeyStates = SDL_GetKeyboardState(NULL);
-            handleGameInput(currentKeyStates);
-            update();
-            render();
 
-            // Check for goal
-            if (ball.x <= leftGoal.x + leftGoal.w) {
-                if (ball.y + ball.r >= leftGoal.y && ball.y <= leftGoal.y + leftGoal.h) {
-                    ++rightScore;
-                    leftPlayerServe = false; // Right player serves next
-                    resetBall(leftPlayerServe);
+        {
+            TRACE_SCOPE("poll events");
+            while (SDL_PollEvent(&e) != 0) {
+                if (e.type == SDL_QUIT) {
+                    quit = true;
+                }
+                if (e.type == SDL_KEYDOWN) {
+                    latencyMark(LatencyStage::POLLED);
+                }
+                if (e.type == SDL_WINDOWEVENT) {
+                    windowStateEvent(e.window);
+                    menuWindowEvent(e.window);
+                }
+                if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_F3 && e.key.repeat == 0) {
+                    toggleHud();
+                    requestMenuRedraw();
+                    continue;
+                }
+                if (inMenu) {
+                    if (dispatchFlowEvent(e)) {
+                        requestMenuRedraw();
+                    }
+                    followGameFlow(inMenu, quit, tickEnd);
+                }
+                else if (replayPlayback) {
+                    handleReplayInput(e, leftPlayerServe);
                 }
+                else {
+                    recordInputEvent(e);
+                }
+            }
+        }
+        phaseStart = hudPhaseEnd(HudPhase::EVENTS, phaseStart);
+
+        // Present only on input, expose events and animation ticks
+        if (inMenu) {
+            if (menuRedrawDue()) {
+                renderMenu();
             }
-            else if (ball.x + ball.r * 2 >= rightGoal.x) {
-                if (ball.y + ball.r >= rightGoal.y && ball.y <= rightGoal.y + rightGoal.h) {
-                    ++leftScore;
-                    leftPlayerServe = true; // Left player serves next
-                    resetBall(leftPlayerServe);
+            hudPhaseEnd(HudPhase::RENDER, phaseStart);
+            continue;
+        }
+
+        // A spectator only shows what the game sends, slightly in the past
+        if (spectating) {
+            if (!pollSpectator(spectatorClient, SDL_GetTicks())) {
+                std::cout << "The game has ended" << std::endl;
+                break;
+            }
+            interpolateSpectator(spectatorClient, SDL_GetTicks());
+            phaseStart = hudPhaseEnd(HudPhase::SIMULATE, phaseStart);
+            if (windowFrameDue()) {
+                render();
+            }
+            hudPhaseEnd(HudPhase::RENDER, phaseStart);
+            TRACE_SCOPE("sleep");
+            SDL_Delay(TICK_MS / 2);
+            continue;
+        }
+
+        // A hidden local game is suspended: no ticks and no frames until the window is back, and the
+        // clock carries on from there. Games with a peer or spectators have to keep ticking.
+        bool suspended = suspendWhenHidden && windowState() == WindowState::HIDDEN;
+        if (simulationThreadActive()) {
+            pauseSimulationThread(suspended);
+        }
+        if (suspended) {
+            TRACE_SCOPE("suspended");
+            waitWhileHidden();
+            tickEnd = SDL_GetTicks() + TICK_MS;
+            continue;
+        }
+
+        // The simulation ticks on its own; draw each state it publishes once, without ever waiting on it
+        if (simulationThreadActive()) {
+            bool fresh = false;
+            const SimSnapshot& snapshot = latestSimSnapshot(fresh);
+            // The old front slot is the producer's again, so follow the new one even when not drawing
+            if (fresh) {
+                drawnState = &snapshot.state;
+            }
+            if (fresh && windowFrameDue()) {
+                render();
+                noteSimSnapshotDrawn();
+                Uint64 renderEnd = hudPhaseEnd(HudPhase::RENDER, phaseStart);
+                recordFrameTime(static_cast<float>(renderEnd - phaseStart) * 1000.0f / SDL_GetPerformanceFrequency());
+            }
+            Sint32 untilNextTick = static_cast<Sint32>(snapshot.nextTickMs - SDL_GetTicks());
+            TRACE_SCOPE("sleep");
+            SDL_Delay(untilNextTick > 0 ? untilNextTick : 1);
+            continue;
+        }
+
+        // Run every tick whose time window has fully elapsed, applying the inputs stamped inside it
+        int ticksRun = 0;
+        while (static_cast<Sint32>(SDL_GetTicks() - tickEnd) >= 0 && ticksRun < MAX_TICKS_PER_FRAME) {
+            TRACE_SCOPE("tick");
+            if (replayPlayback) {
+                if (!playbackPaused && !runReplayTicks(playbackSpeed, leftPlayerServe)) {
+                    std::cout << "Replay finished after " << replayReader.tick << " ticks" << std::endl;
+                    quit = true;
+                    break;
                 }
             }
+            else if (gameFlowActive()) {
+                tickFlow(tickEnd);
+            }
+            else {
+                runGameTick(sampleTickInput(tickEnd), leftPlayerServe);
+            }
+            if (spectatorPort != 0) {
+                broadcastSnapshot(spectatorServer, spectatorTick++);
+            }
+            tickEnd += TICK_MS;
+            ++ticksRun;
+        }
+
+        // After the serve pause or a long stall, carry on from now instead of fast-forwarding
+        if (static_cast<Sint32>(SDL_GetTicks() - tickEnd) >= static_cast<Sint32>(TICK_MS)) {
+            tickEnd = SDL_GetTicks() + TICK_MS;
+        }
+        Uint64 renderStart = hudPhaseEnd(HudPhase::SIMULATE, phaseStart);
+
+        // Hidden or throttled while unfocused, the ticks above still ran and nothing else changes
+        if (windowFrameDue()) {
+            render();
+            Uint64 renderEnd = hudPhaseEnd(HudPhase::RENDER, renderStart);
+            recordFrameTime(static_cast<float>(renderEnd - renderStart) * 1000.0f / SDL_GetPerformanceFrequency());
         }
 
-        SDL_Delay(10);
+        // Sleep until the next tick is due
+        Sint32 untilNextTick = static_cast<Sint32>(tickEnd - SDL_GetTicks());
+        if (untilNextTick > 0 && !allocationCheckActive()) {
+            TRACE_SCOPE("sleep");
+            SDL_Delay(untilNextTick);
+        }
     }
 
+    // The game globals are the main thread's again once the simulation has stopped
+    stopSimulationThread();
+    drawnState = &gameState;
+    stopGameFlow();
+    reportLatencyProbe();
+    reportIdleCheck();
+    reportWindowStates();
+    bool allocationsOk = reportAllocationCheck();
+    finishReplayRecording(replayWriter);
+    closeReplay(replayReader);
+    if (netplayActive) {
+        netTransport.close();
+    }
+    if (spectatorPort != 0) {
+        closeSpectatorServer(spectatorServer);
+    }
+    if (spectating) {
+        closeSpectator(spectatorClient);
+    }
+    if (networkUsed) {
+        shutdownNetwork();
+    }
     close();
-    return 0;
-}
\ No newline at end of file
+    return allocationsOk ? 0 : 1;
+}
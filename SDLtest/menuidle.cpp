@@ -0,0 +1,128 @@
+#include "menuidle.h"
+#include "perfhud.h"
+#include "windowstate.h"
+#include <ctime>
+#include <iostream>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+static bool redrawRequested = true;     // the first wake draws the menu
+static Uint32 lastDrawMs = 0;
+
+static bool checkEnabled = false;
+static Uint32 checkMs = 0;
+static bool checkStarted = false;
+static Uint32 checkStartMs = 0;
+static double checkStartCpu = 0.0;
+static Uint32 wakeups = 0;
+static Uint32 presents = 0;
+
+// Function to get the CPU time used by every thread of the process so far, in seconds
+static double processCpuSeconds() {
+#ifdef _WIN32
+    // clock() is wall time on Windows
+    FILETIME created, exited, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user)) {
+        return 0.0;
+    }
+    ULARGE_INTEGER kernelTime, userTime;
+    kernelTime.LowPart = kernel.dwLowDateTime;
+    kernelTime.HighPart = kernel.dwHighDateTime;
+    userTime.LowPart = user.dwLowDateTime;
+    userTime.HighPart = user.dwHighDateTime;
+    return static_cast<double>(kernelTime.QuadPart + userTime.QuadPart) * 1e-7;
+#else
+    return static_cast<double>(std::clock()) / CLOCKS_PER_SEC;
+#endif
+}
+
+void requestMenuRedraw() {
+    redrawRequested = true;
+}
+
+void menuWindowEvent(const SDL_WindowEvent& e) {
+    switch (e.event) {
+    case SDL_WINDOWEVENT_SHOWN:
+    case SDL_WINDOWEVENT_EXPOSED:
+    case SDL_WINDOWEVENT_SIZE_CHANGED:
+    case SDL_WINDOWEVENT_RESTORED:
+        redrawRequested = true;
+        break;
+    default:
+        break;
+    }
+}
+
+void waitForMenuWake() {
+    // A hidden window keeps its redraw request until it is shown again
+    if (redrawRequested && windowVisible()) {
+        return;
+    }
+    Uint32 now = SDL_GetTicks();
+    Sint32 timeout = static_cast<Sint32>(MENU_IDLE_WAIT_MS);
+    // The overlay is the only thing on the menu that changes by itself
+    if (hudVisible() && windowVisible()) {
+        Sint32 untilRefresh = static_cast<Sint32>(lastDrawMs + HUD_REFRESH_MS - now);
+        timeout = untilRefresh < timeout ? untilRefresh : timeout;
+    }
+    if (checkStarted) {
+        Sint32 untilEnd = static_cast<Sint32>(checkStartMs + checkMs - now);
+        timeout = untilEnd < timeout ? untilEnd : timeout;
+    }
+    if (timeout > 0) {
+        SDL_WaitEventTimeout(nullptr, timeout);
+    }
+    ++wakeups;
+}
+
+bool menuRedrawDue() {
+    if (!windowVisible()) {
+        return false;
+    }
+    Uint32 now = SDL_GetTicks();
+    bool due = redrawRequested || (hudVisible() && now - lastDrawMs >= HUD_REFRESH_MS);
+    if (due) {
+        redrawRequested = false;
+        lastDrawMs = now;
+        ++presents;
+    }
+    return due;
+}
+
+void startIdleCheck(int seconds) {
+    checkEnabled = true;
+    checkMs = static_cast<Uint32>(seconds > 0 ? seconds : 1) * 1000;
+}
+
+bool idleCheckActive() {
+    return checkEnabled;
+}
+
+bool idleCheckStep() {
+    // The clock starts on the first menu frame, once loading is over
+    if (!checkStarted) {
+        checkStarted = true;
+        checkStartMs = SDL_GetTicks();
+        checkStartCpu = processCpuSeconds();
+        wakeups = 0;
+        presents = 0;
+        return true;
+    }
+    return SDL_GetTicks() - checkStartMs < checkMs;
+}
+
+void reportIdleCheck() {
+    if (!checkStarted) {
+        return;
+    }
+    double seconds = (SDL_GetTicks() - checkStartMs) / 1000.0;
+    double cpuSeconds = processCpuSeconds() - checkStartCpu;
+    if (seconds <= 0.0) {
+        return;
+    }
+    std::cout << "Menu idle check over " << seconds << " s: " << cpuSeconds * 1000.0 << " ms CPU, "
+              << cpuSeconds / seconds * 100.0 << "% of one core" << std::endl;
+    std::cout << "  " << wakeups << " wakeups (" << wakeups / seconds << "/s), " << presents << " presents" << std::endl;
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <SDL.h>
+
+// Longest the menu sleeps when nothing on it animates; only bounds how often an idle menu wakes up
+const Uint32 MENU_IDLE_WAIT_MS = 1000;
+
+// Function to have the menu drawn on its next wake: after input, or on coming back from a match
+void requestMenuRedraw();
+
+// Function to redraw the menu when the window says its contents were lost or resized
+void menuWindowEvent(const SDL_WindowEvent& e);
+
+// Function to block in SDL_WaitEventTimeout until an event is queued or the menu's next animation
+// tick (the overlay's refresh, the end of the idle check) is due. The event stays in the queue.
+void waitForMenuWake();
+
+// Function to check whether the menu needs presenting now; clears the request when it does
+bool menuRedrawDue();
+
+// Function to enable the idle check: leave the menu alone for this many seconds, then report its CPU use
+void startIdleCheck(int seconds);
+
+// Function to check whether the game is running as an idle check
+bool idleCheckActive();
+
+// Function to drive the check once per main loop iteration, returns false when the time is up
+bool idleCheckStep();
+
+// Function to print the process CPU time, wakeups and presents over the check
+void reportIdleCheck();
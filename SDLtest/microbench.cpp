@@ -0,0 +1,176 @@
+#include "microbench.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+const void* volatile benchEscape = nullptr;
+
+struct Benchmark {
+    const char* name;
+    BenchmarkFunction function;
+};
+
+// One timed repetition
+struct BenchRun {
+    Uint64 iterations;
+    double realNs;              // per iteration
+    double cpuNs;
+};
+
+static std::vector<Benchmark> benchmarks;
+
+void registerBenchmark(const char* name, BenchmarkFunction function) {
+    benchmarks.push_back({ name, function });
+}
+
+// Function to get the CPU time the calling thread has used so far, in seconds
+static double threadCpuSeconds() {
+#ifdef _WIN32
+    // clock() is wall time on Windows
+    FILETIME created, exited, kernel, user;
+    if (!GetThreadTimes(GetCurrentThread(), &created, &exited, &kernel, &user)) {
+        return 0.0;
+    }
+    ULARGE_INTEGER kernelTime, userTime;
+    kernelTime.LowPart = kernel.dwLowDateTime;
+    kernelTime.HighPart = kernel.dwHighDateTime;
+    userTime.LowPart = user.dwLowDateTime;
+    userTime.HighPart = user.dwHighDateTime;
+    return static_cast<double>(kernelTime.QuadPart + userTime.QuadPart) * 1e-7;
+#else
+    return static_cast<double>(std::clock()) / CLOCKS_PER_SEC;
+#endif
+}
+
+static BenchRun timeRun(BenchmarkFunction function, Uint64 iterations) {
+    double cpuStart = threadCpuSeconds();
+    Uint64 start = SDL_GetPerformanceCounter();
+    function(iterations);
+    Uint64 elapsed = SDL_GetPerformanceCounter() - start;
+    double cpuElapsed = threadCpuSeconds() - cpuStart;
+    BenchRun run;
+    run.iterations = iterations;
+    run.realNs = 1e9 * elapsed / SDL_GetPerformanceFrequency() / iterations;
+    run.cpuNs = 1e9 * cpuElapsed / iterations;
+    return run;
+}
+
+// Function to find an iteration count that runs for BENCH_MIN_SECONDS, growing it until the timing is meaningful
+static Uint64 calibrate(BenchmarkFunction function) {
+    Uint64 iterations = 1;
+    while (true) {
+        BenchRun run = timeRun(function, iterations);
+        double seconds = run.realNs * iterations * 1e-9;
+        if (seconds >= BENCH_MIN_SECONDS || iterations >= (1ull << 40)) {
+            return iterations;
+        }
+        // Aim a little past the target, but grow at most tenfold on a run too short to trust
+        double scale = seconds > 0.01 ? 1.2 * BENCH_MIN_SECONDS / seconds : 10.0;
+        Uint64 next = static_cast<Uint64>(iterations * (scale < 10.0 ? scale : 10.0));
+        iterations = next > iterations ? next : iterations + 1;
+    }
+}
+
+static void writeJsonRun(FILE* file, bool& first, const char* name, const char* runType, const char* aggregate,
+                         int index, Uint64 iterations, double realNs, double cpuNs) {
+    std::fprintf(file, "%s\n    {\n", first ? "" : ",");
+    first = false;
+    if (aggregate != nullptr) {
+        std::fprintf(file, "      \"name\": \"%s_%s\",\n", name, aggregate);
+    }
+    else {
+        std::fprintf(file, "      \"name\": \"%s\",\n", name);
+    }
+    std::fprintf(file, "      \"run_name\": \"%s\",\n      \"run_type\": \"%s\",\n      \"repetitions\": %d,\n", name, runType, BENCH_REPETITIONS);
+    if (aggregate != nullptr) {
+        std::fprintf(file, "      \"aggregate_name\": \"%s\",\n", aggregate);
+    }
+    else {
+        std::fprintf(file, "      \"repetition_index\": %d,\n", index);
+    }
+    std::fprintf(file, "      \"threads\": 1,\n      \"iterations\": %llu,\n      \"real_time\": %.4f,\n      \"cpu_time\": %.4f,\n"
+        "      \"time_unit\": \"ns\"\n    }", static_cast<unsigned long long>(iterations), realNs, cpuNs);
+}
+
+bool runBenchmarks(const char* filter, const char* jsonPath) {
+    FILE* json = nullptr;
+    bool first = true;
+    if (jsonPath != nullptr) {
+        json = std::fopen(jsonPath, "w");
+        if (json == nullptr) {
+            std::cerr << "Unable to create " << jsonPath << std::endl;
+            return false;
+        }
+        char date[64];
+        std::time_t now = std::time(nullptr);
+        std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+#ifdef NDEBUG
+        const char* buildType = "release";
+#else
+        const char* buildType = "debug";
+#endif
+        std::fprintf(json, "{\n  \"context\": {\n    \"date\": \"%s\",\n    \"num_cpus\": %d,\n    \"library_build_type\": \"%s\"\n  },\n"
+            "  \"benchmarks\": [", date, SDL_GetCPUCount(), buildType);
+    }
+
+    std::printf("%-32s %14s %14s %12s\n", "Benchmark", "Time (median)", "CPU (median)", "Iterations");
+    int ran = 0;
+    for (const Benchmark& benchmark : benchmarks) {
+        if (filter != nullptr && std::strstr(benchmark.name, filter) == nullptr) {
+            continue;
+        }
+        Uint64 iterations = calibrate(benchmark.function);
+        BenchRun runs[BENCH_REPETITIONS];
+        for (int i = 0; i < BENCH_REPETITIONS; ++i) {
+            runs[i] = timeRun(benchmark.function, iterations);
+        }
+
+        double real[BENCH_REPETITIONS], cpu[BENCH_REPETITIONS];
+        double realMean = 0.0, cpuMean = 0.0;
+        for (int i = 0; i < BENCH_REPETITIONS; ++i) {
+            real[i] = runs[i].realNs;
+            cpu[i] = runs[i].cpuNs;
+            realMean += real[i] / BENCH_REPETITIONS;
+            cpuMean += cpu[i] / BENCH_REPETITIONS;
+        }
+        double realDeviation = 0.0, cpuDeviation = 0.0;
+        for (int i = 0; i < BENCH_REPETITIONS; ++i) {
+            realDeviation += (real[i] - realMean) * (real[i] - realMean) / (BENCH_REPETITIONS - 1);
+            cpuDeviation += (cpu[i] - cpuMean) * (cpu[i] - cpuMean) / (BENCH_REPETITIONS - 1);
+        }
+        std::sort(real, real + BENCH_REPETITIONS);
+        std::sort(cpu, cpu + BENCH_REPETITIONS);
+        double realMedian = real[BENCH_REPETITIONS / 2];
+        double cpuMedian = cpu[BENCH_REPETITIONS / 2];
+
+        std::printf("%-32s %11.1f ns %11.1f ns %12llu  (+/- %.1f%%)\n", benchmark.name, realMedian, cpuMedian,
+            static_cast<unsigned long long>(iterations), realMean > 0.0 ? 100.0 * std::sqrt(realDeviation) / realMean : 0.0);
+        if (json != nullptr) {
+            for (int i = 0; i < BENCH_REPETITIONS; ++i) {
+                writeJsonRun(json, first, benchmark.name, "iteration", nullptr, i, iterations, runs[i].realNs, runs[i].cpuNs);
+            }
+            writeJsonRun(json, first, benchmark.name, "aggregate", "mean", 0, iterations, realMean, cpuMean);
+            writeJsonRun(json, first, benchmark.name, "aggregate", "median", 0, iterations, realMedian, cpuMedian);
+            writeJsonRun(json, first, benchmark.name, "aggregate", "stddev", 0, iterations, std::sqrt(realDeviation), std::sqrt(cpuDeviation));
+        }
+        ++ran;
+    }
+
+    bool written = true;
+    if (json != nullptr) {
+        std::fprintf(json, "\n  ]\n}\n");
+        written = std::fclose(json) == 0;
+    }
+    if (ran == 0) {
+        std::cerr << "No benchmark matches " << (filter != nullptr ? filter : "") << std::endl;
+    }
+    return ran > 0 && written;
+}
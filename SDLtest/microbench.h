@@ -0,0 +1,23 @@
+#pragma once
+#include <SDL.h>
+
+// A benchmark body: runs the code being measured `iterations` times
+typedef void (*BenchmarkFunction)(Uint64 iterations);
+
+// Each repetition runs at least this long, after a calibration pass picks the iteration count
+const double BENCH_MIN_SECONDS = 0.2;
+const int BENCH_REPETITIONS = 5;
+
+// Function to add a benchmark to the suite
+void registerBenchmark(const char* name, BenchmarkFunction function);
+
+// Function to run every benchmark whose name contains filter (nullptr runs all), print a table and, given a path,
+// write the results in Google Benchmark's JSON format. Returns false if nothing ran or the file couldn't be written.
+bool runBenchmarks(const char* filter, const char* jsonPath);
+
+// Function to make the compiler keep a result it could otherwise prove unused
+extern const void* volatile benchEscape;
+template <typename T>
+inline void benchKeep(const T& value) {
+    benchEscape = &value;
+}
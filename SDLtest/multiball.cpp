@@ -0,0 +1,287 @@
+#include "multiball.h"
+#include "spritebatch.h"
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+
+// Function to get the next value of a small xorshift generator
+static unsigned nextRandom(unsigned& state) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+void initArena(BallArena& arena, int count, unsigned seed) {
+    arena.count = count;
+    arena.x.resize(count);
+    arena.y.resize(count);
+    arena.dx.resize(count);
+    arena.dy.resize(count);
+    arena.cell.resize(count);
+    arena.sorted.resize(count);
+    arena.cellStart.resize(ARENA_GRID_WIDTH * ARENA_GRID_HEIGHT + 1);
+
+    unsigned state = seed != 0 ? seed : 1;
+    const int diameter = 2 * ARENA_BALL_RADIUS;
+    for (int i = 0; i < count; ++i) {
+        // Keep clear of the goals and paddles
+        arena.x[i] = static_cast<float>(60 + nextRandom(state) % (SCREEN_WIDTH - 120 - diameter));
+        arena.y[i] = static_cast<float>(10 + nextRandom(state) % (SCREEN_HEIGHT - 20 - diameter));
+        float angle = (nextRandom(state) % 3600) * static_cast<float>(M_PI) / 1800.0f;
+        float speed = 1.0f + (nextRandom(state) % 400) / 100.0f;
+        arena.dx[i] = speed * std::cos(angle);
+        arena.dy[i] = speed * std::sin(angle);
+    }
+    arena.stats = ArenaStats();
+}
+
+// Kernel: move every ball and bounce it off the top/bottom borders and side walls
+static void moveBalls(BallArena& arena) {
+    const int n = arena.count;
+    float* x = arena.x.data();
+    float* y = arena.y.data();
+    float* dx = arena.dx.data();
+    float* dy = arena.dy.data();
+    const float maxX = static_cast<float>(SCREEN_WIDTH - 2 * ARENA_BALL_RADIUS);
+    const float maxY = static_cast<float>(SCREEN_HEIGHT - 2 * ARENA_BALL_RADIUS);
+    // Branch-free selects so the compiler can vectorise the loop
+    for (int i = 0; i < n; ++i) {
+        float nx = x[i] + dx[i];
+        float ny = y[i] + dy[i];
+        dx[i] = (nx <= 0.0f || nx >= maxX) ? -dx[i] : dx[i];
+        dy[i] = (ny <= 0.0f || ny >= maxY) ? -dy[i] : dy[i];
+        // Unlike the single ball, keep arena balls inside so crowds can't push them through a wall
+        x[i] = std::min(std::max(nx, 0.0f), maxX);
+        y[i] = std::min(std::max(ny, 0.0f), maxY);
+    }
+}
+
+// Kernel: score balls that reach a goal and serve them again from the centre
+static void scoreGoals(BallArena& arena) {
+    const int n = arena.count;
+    float* x = arena.x.data();
+    float* y = arena.y.data();
+    float* dx = arena.dx.data();
+    const float diameter = 2.0f * ARENA_BALL_RADIUS;
+    const float leftLine = static_cast<float>(leftGoal.x + leftGoal.w);
+    const float rightLine = static_cast<float>(rightGoal.x);
+    const float goalTop = static_cast<float>(leftGoal.y);
+    const float goalBottom = static_cast<float>(leftGoal.y + leftGoal.h);
+    int leftGoals = 0;
+    int rightGoals = 0;
+    for (int i = 0; i < n; ++i) {
+        bool inMouth = y[i] + ARENA_BALL_RADIUS >= goalTop && y[i] <= goalBottom;
+        bool intoLeft = inMouth && x[i] <= leftLine;
+        bool intoRight = inMouth && x[i] + diameter >= rightLine;
+        leftGoals += intoLeft;
+        rightGoals += intoRight;
+        // The side that conceded receives the serve, as in resetBall()
+        x[i] = (intoLeft || intoRight) ? SCREEN_WIDTH / 2.0f - ARENA_BALL_RADIUS : x[i];
+        dx[i] = intoLeft ? -std::fabs(dx[i]) : (intoRight ? std::fabs(dx[i]) : dx[i]);
+    }
+    rightScore += leftGoals;
+    leftScore += rightGoals;
+    if (leftGoals + rightGoals > 0) {
+        gameSoundHandler(GameSound::GOAL);
+    }
+}
+
+// Kernel: the three-zone paddle bounce from update() for one paddle
+static void bounceOffPaddle(BallArena& arena, const Paddle& paddle) {
+    const int n = arena.count;
+    const float* x = arena.x.data();
+    const float* y = arena.y.data();
+    float* dx = arena.dx.data();
+    float* dy = arena.dy.data();
+    const float diameter = 2.0f * ARENA_BALL_RADIUS;
+    const float left = static_cast<float>(paddle.x);
+    const float right = static_cast<float>(paddle.x + paddle.w);
+    const float top = static_cast<float>(paddle.y);
+    const float third = static_cast<float>(paddle.h / 3);
+    const float bottom = top + 3.0f * third;
+    const float speedY = static_cast<float>(tuning.ballSpeedY);
+    bool hit = false;
+    for (int i = 0; i < n; ++i) {
+        // Same inclusive overlap test as checkCollision()
+        bool overlaps = x[i] + diameter >= left && right >= x[i] && y[i] + diameter >= top && bottom >= y[i];
+        // Zones are tried top first, as in update()
+        float zoneSpeed = y[i] <= top + third ? -speedY : (y[i] <= top + 2.0f * third ? 0.0f : speedY);
+        dx[i] = overlaps ? -dx[i] : dx[i];
+        dy[i] = overlaps ? zoneSpeed : dy[i];
+        hit = hit || overlaps;
+    }
+    if (hit) {
+        gameSoundHandler(GameSound::PADDLE);
+    }
+}
+
+// Function to rebuild the grid with a counting sort by cell
+static void buildGrid(BallArena& arena) {
+    const int n = arena.count;
+    const int cells = ARENA_GRID_WIDTH * ARENA_GRID_HEIGHT;
+    int* cellStart = arena.cellStart.data();
+    int* cell = arena.cell.data();
+    std::fill(arena.cellStart.begin(), arena.cellStart.end(), 0);
+
+    for (int i = 0; i < n; ++i) {
+        int cx = static_cast<int>((arena.x[i] + ARENA_BALL_RADIUS) / ARENA_CELL_SIZE);
+        int cy = static_cast<int>((arena.y[i] + ARENA_BALL_RADIUS) / ARENA_CELL_SIZE);
+        cx = std::min(std::max(cx, 0), ARENA_GRID_WIDTH - 1);
+        cy = std::min(std::max(cy, 0), ARENA_GRID_HEIGHT - 1);
+        cell[i] = cy * ARENA_GRID_WIDTH + cx;
+        ++cellStart[cell[i] + 1];
+    }
+    for (int c = 0; c < cells; ++c) {
+        cellStart[c + 1] += cellStart[c];
+    }
+    // Scatter using cellStart as a running cursor, then shift it back
+    for (int i = 0; i < n; ++i) {
+        arena.sorted[cellStart[cell[i]]++] = i;
+    }
+    for (int c = cells; c > 0; --c) {
+        cellStart[c] = cellStart[c - 1];
+    }
+    cellStart[0] = 0;
+}
+
+// Function to resolve one pair of touching balls: equal masses, so they swap velocity along the normal
+static bool collidePair(BallArena& arena, int a, int b) {
+    const float diameter = 2.0f * ARENA_BALL_RADIUS;
+    float nx = arena.x[b] - arena.x[a];
+    float ny = arena.y[b] - arena.y[a];
+    float distanceSquared = nx * nx + ny * ny;
+    if (distanceSquared >= diameter * diameter || distanceSquared == 0.0f) {
+        return false;
+    }
+    float distance = std::sqrt(distanceSquared);
+    nx /= distance;
+    ny /= distance;
+
+    // Push apart so they don't stay stuck together
+    float push = (diameter - distance) * 0.5f;
+    arena.x[a] -= nx * push;
+    arena.y[a] -= ny * push;
+    arena.x[b] += nx * push;
+    arena.y[b] += ny * push;
+
+    float approach = (arena.dx[a] - arena.dx[b]) * nx + (arena.dy[a] - arena.dy[b]) * ny;
+    if (approach > 0.0f) {
+        arena.dx[a] -= approach * nx;
+        arena.dy[a] -= approach * ny;
+        arena.dx[b] += approach * nx;
+        arena.dy[b] += approach * ny;
+    }
+    return true;
+}
+
+// Function to test every ball against its own cell and the four "forward" neighbours, so each pair is seen once
+static void collideBalls(BallArena& arena) {
+    static const int forward[4][2] = { { 1, 0 }, { -1, 1 }, { 0, 1 }, { 1, 1 } };
+    const int* cellStart = arena.cellStart.data();
+    const int* sorted = arena.sorted.data();
+    int pairTests = 0;
+    int contacts = 0;
+    for (int cy = 0; cy < ARENA_GRID_HEIGHT; ++cy) {
+        for (int cx = 0; cx < ARENA_GRID_WIDTH; ++cx) {
+            int c = cy * ARENA_GRID_WIDTH + cx;
+            int begin = cellStart[c];
+            int end = cellStart[c + 1];
+            if (begin == end) {
+                continue;
+            }
+            for (int i = begin; i < end; ++i) {
+                for (int j = i + 1; j < end; ++j) {
+                    ++pairTests;
+                    contacts += collidePair(arena, sorted[i], sorted[j]);
+                }
+            }
+            for (int k = 0; k < 4; ++k) {
+                int ox = cx + forward[k][0];
+                int oy = cy + forward[k][1];
+                if (ox < 0 || ox >= ARENA_GRID_WIDTH || oy >= ARENA_GRID_HEIGHT) {
+                    continue;
+                }
+                int other = oy * ARENA_GRID_WIDTH + ox;
+                for (int i = begin; i < end; ++i) {
+                    for (int j = cellStart[other]; j < cellStart[other + 1]; ++j) {
+                        ++pairTests;
+                        contacts += collidePair(arena, sorted[i], sorted[j]);
+                    }
+                }
+            }
+        }
+    }
+    arena.stats.pairTests = pairTests;
+    arena.stats.contacts = contacts;
+}
+
+void updateArena(BallArena& arena) {
+    Uint64 start = SDL_GetPerformanceCounter();
+    moveBalls(arena);
+    scoreGoals(arena);
+    bounceOffPaddle(arena, leftPaddle);
+    bounceOffPaddle(arena, rightPaddle);
+    Uint64 moved = SDL_GetPerformanceCounter();
+    buildGrid(arena);
+    Uint64 gridded = SDL_GetPerformanceCounter();
+    collideBalls(arena);
+    Uint64 done = SDL_GetPerformanceCounter();
+
+    arena.stats.moveCounter = moved - start;
+    arena.stats.gridCounter = gridded - moved;
+    arena.stats.collideCounter = done - gridded;
+}
+
+void drawArena(const BallArena& arena) {
+    const int diameter = 2 * ARENA_BALL_RADIUS;
+    SDL_Color color = { 255, 128, 0, 255 };
+    for (int i = 0; i < arena.count; ++i) {
+        SDL_Rect dst = { static_cast<int>(arena.x[i]), static_cast<int>(arena.y[i]), diameter, diameter };
+        batchFillRect(dst, color);
+    }
+}
+
+void runArenaBenchmark(int balls, int ticks) {
+    BallArena arena;
+    initArena(arena, balls, 7);
+    resetPaddles();
+    leftScore = 0;
+    rightScore = 0;
+
+    double frequency = static_cast<double>(SDL_GetPerformanceFrequency());
+    Uint64 totals[3] = { 0, 0, 0 };
+    Uint64 worst = 0;
+    Uint64 pairTests = 0;
+    Uint64 contacts = 0;
+    for (int tick = 0; tick < ticks; ++tick) {
+        // Sweep the paddles so the paddle kernel has work
+        bool up = (tick / 60) % 2 == 0;
+        movePaddle(leftPaddle, up, !up);
+        movePaddle(rightPaddle, !up, up);
+        updateArena(arena);
+
+        const ArenaStats& stats = arena.stats;
+        totals[0] += stats.moveCounter;
+        totals[1] += stats.gridCounter;
+        totals[2] += stats.collideCounter;
+        worst = std::max(worst, stats.moveCounter + stats.gridCounter + stats.collideCounter);
+        pairTests += stats.pairTests;
+        contacts += stats.contacts;
+    }
+
+    double toMs = 1000.0 / frequency / ticks;
+    double average = (totals[0] + totals[1] + totals[2]) * toMs;
+    const double budget120Hz = 1000.0 / 120.0;
+    std::cout << "Arena benchmark: " << balls << " balls, " << ticks << " ticks on one core" << std::endl;
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "  move/walls/goals/paddles: " << totals[0] * toMs << " ms/tick" << std::endl;
+    std::cout << "  grid rebuild:             " << totals[1] * toMs << " ms/tick" << std::endl;
+    std::cout << "  ball-vs-ball:             " << totals[2] * toMs << " ms/tick (" << pairTests / ticks << " pair tests, "
+        << contacts / ticks << " contacts)" << std::endl;
+    std::cout << "  total:                    " << average << " ms/tick average, " << worst * 1000.0 / frequency << " ms worst, "
+        << std::setprecision(1) << average / budget120Hz * 100.0 << "% of a 120 Hz tick" << std::endl;
+    std::cout << "  score " << leftScore << " - " << rightScore << std::endl;
+    std::cout.unsetf(std::ios::fixed);
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include "game.h"
+#include <vector>
+
+// Arena balls are small so thousands fit on the field
+const int ARENA_BALL_RADIUS = 3;
+const int ARENA_DEFAULT_BALLS = 10000;
+// Grid cells are one ball across, so touching balls are always in the same or a neighbouring cell
+const int ARENA_CELL_SIZE = 2 * ARENA_BALL_RADIUS;
+const int ARENA_GRID_WIDTH = (SCREEN_WIDTH + ARENA_CELL_SIZE - 1) / ARENA_CELL_SIZE;
+const int ARENA_GRID_HEIGHT = (SCREEN_HEIGHT + ARENA_CELL_SIZE - 1) / ARENA_CELL_SIZE;
+
+// Time spent in each stage of the last updateArena() call, in SDL performance counter ticks
+struct ArenaStats {
+    Uint64 moveCounter;         // integrate, walls, goals and paddles
+    Uint64 gridCounter;         // spatial hash rebuild
+    Uint64 collideCounter;      // ball-vs-ball tests and responses
+    int pairTests;
+    int contacts;
+};
+
+// Multiball arena: every ball's fields in their own array so the per-ball kernels stream through memory
+struct BallArena {
+    int count;
+    std::vector<float> x, y;    // top-left corner, like Ball
+    std::vector<float> dx, dy;
+    // Uniform grid rebuilt every tick: balls counting-sorted by cell
+    std::vector<int> cell;      // cell of each ball
+    std::vector<int> cellStart; // first entry in sorted for each cell, plus an end marker
+    std::vector<int> sorted;    // ball indices grouped by cell
+    ArenaStats stats;
+};
+
+// Function to fill the arena with balls at random places, all storage allocated up front
+void initArena(BallArena& arena, int count, unsigned seed);
+
+// Function to advance every ball one tick: the wall, goal and paddle rules of update() as batch
+// kernels over the arrays, then ball-vs-ball collisions through the grid
+void updateArena(BallArena& arena);
+
+// Function to queue every ball into the sprite batch, so they all go out in one geometry call
+void drawArena(const BallArena& arena);
+
+// Function to time updateArena() headless and report it against a 120 Hz tick
+void runArenaBenchmark(int balls, int ticks);
@@ -0,0 +1,242 @@
+#include "net.h"
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+typedef int socklen_t;
+#define NET_INVALID_SOCKET INVALID_SOCKET
+#define closeSocket closesocket
+#define NET_WOULD_BLOCK (WSAGetLastError() == WSAEWOULDBLOCK)
+#define NET_SEND_FLAGS 0
+#else
+#include <arpa/inet.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#define NET_INVALID_SOCKET (-1)
+#define closeSocket ::close
+#define NET_WOULD_BLOCK (errno == EAGAIN || errno == EWOULDBLOCK)
+#ifdef MSG_NOSIGNAL
+#define NET_SEND_FLAGS MSG_NOSIGNAL // A spectator hanging up must not kill the game with SIGPIPE
+#else
+#define NET_SEND_FLAGS 0
+#endif
+#endif
+
+bool initializeNetwork() {
+#ifdef _WIN32
+    WSADATA data;
+    if (WSAStartup(MAKEWORD(2, 2), &data) != 0) {
+        std::cerr << "Winsock could not initialize!" << std::endl;
+        return false;
+    }
+#endif
+    return true;
+}
+
+void shutdownNetwork() {
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
+
+// Function to switch a socket to non-blocking mode
+static bool setNonBlocking(NetSocketHandle handle) {
+#ifdef _WIN32
+    u_long enabled = 1;
+    return ioctlsocket(handle, FIONBIO, &enabled) == 0;
+#else
+    int flags = fcntl(handle, F_GETFL, 0);
+    return flags >= 0 && fcntl(handle, F_SETFL, flags | O_NONBLOCK) == 0;
+#endif
+}
+
+UdpTransport::UdpTransport() : handle(NET_INVALID_SOCKET), hasPeer(false) {
+    std::memset(&peer, 0, sizeof(peer));
+}
+
+UdpTransport::~UdpTransport() {
+    close();
+}
+
+bool UdpTransport::open(Uint16 localPort, const char* peerHost, Uint16 peerPort) {
+    handle = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (handle == NET_INVALID_SOCKET) {
+        std::cerr << "UDP socket could not be created!" << std::endl;
+        return false;
+    }
+
+    sockaddr_in local;
+    std::memset(&local, 0, sizeof(local));
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    local.sin_port = htons(localPort);
+    if (bind(handle, reinterpret_cast<sockaddr*>(&local), sizeof(local)) != 0) {
+        std::cerr << "UDP socket could not bind port " << localPort << "!" << std::endl;
+        close();
+        return false;
+    }
+    if (!setNonBlocking(handle)) {
+        std::cerr << "UDP socket could not be made non-blocking!" << std::endl;
+        close();
+        return false;
+    }
+
+    if (peerHost != nullptr) {
+        addrinfo hints;
+        std::memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_DGRAM;
+        addrinfo* result = nullptr;
+        if (getaddrinfo(peerHost, NULL, &hints, &result) != 0 || result == nullptr) {
+            std::cerr << "Could not resolve " << peerHost << "!" << std::endl;
+            close();
+            return false;
+        }
+        std::memcpy(&peer, result->ai_addr, sizeof(peer));
+        peer.sin_port = htons(peerPort);
+        freeaddrinfo(result);
+        hasPeer = true;
+    }
+    return true;
+}
+
+void UdpTransport::close() {
+    if (handle != NET_INVALID_SOCKET) {
+        closeSocket(handle);
+        handle = NET_INVALID_SOCKET;
+    }
+    hasPeer = false;
+}
+
+void UdpTransport::send(const Uint8* data, int size) {
+    if (handle == NET_INVALID_SOCKET || !hasPeer) {
+        return;
+    }
+    sendto(handle, reinterpret_cast<const char*>(data), size, 0, reinterpret_cast<const sockaddr*>(&peer), sizeof(peer));
+}
+
+int UdpTransport::receive(Uint8* buffer, int capacity) {
+    if (handle == NET_INVALID_SOCKET) {
+        return 0;
+    }
+    sockaddr_in from;
+    socklen_t fromSize = sizeof(from);
+    int received = static_cast<int>(recvfrom(handle, reinterpret_cast<char*>(buffer), capacity, 0, reinterpret_cast<sockaddr*>(&from), &fromSize));
+    if (received <= 0) {
+        return 0;
+    }
+    // The hosting side learns who it is playing from the first datagram, strangers are ignored after that
+    if (!hasPeer) {
+        peer = from;
+        hasPeer = true;
+    }
+    else if (from.sin_addr.s_addr != peer.sin_addr.s_addr || from.sin_port != peer.sin_port) {
+        return 0;
+    }
+    return received;
+}
+
+// Function to send small messages immediately instead of waiting to coalesce them
+static void setNoDelay(NetSocketHandle handle) {
+    int enabled = 1;
+    setsockopt(handle, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&enabled), sizeof(enabled));
+}
+
+NetSocketHandle openTcpListener(Uint16 port) {
+    NetSocketHandle listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (listener == NET_INVALID_SOCKET) {
+        std::cerr << "TCP socket could not be created!" << std::endl;
+        return NET_INVALID_SOCKET;
+    }
+    int reuse = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+
+    sockaddr_in local;
+    std::memset(&local, 0, sizeof(local));
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    local.sin_port = htons(port);
+    if (bind(listener, reinterpret_cast<sockaddr*>(&local), sizeof(local)) != 0 || listen(listener, SOMAXCONN) != 0) {
+        std::cerr << "TCP socket could not listen on port " << port << "!" << std::endl;
+        closeSocket(listener);
+        return NET_INVALID_SOCKET;
+    }
+    if (!setNonBlocking(listener)) {
+        std::cerr << "TCP socket could not be made non-blocking!" << std::endl;
+        closeSocket(listener);
+        return NET_INVALID_SOCKET;
+    }
+    return listener;
+}
+
+NetSocketHandle acceptTcpConnection(NetSocketHandle listener) {
+    NetSocketHandle handle = accept(listener, NULL, NULL);
+    if (handle == NET_INVALID_SOCKET) {
+        return NET_INVALID_SOCKET;
+    }
+    if (!setNonBlocking(handle)) {
+        closeSocket(handle);
+        return NET_INVALID_SOCKET;
+    }
+    setNoDelay(handle);
+    return handle;
+}
+
+NetSocketHandle connectTcp(const char* host, Uint16 port) {
+    addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* result = nullptr;
+    if (getaddrinfo(host, NULL, &hints, &result) != 0 || result == nullptr) {
+        std::cerr << "Could not resolve " << host << "!" << std::endl;
+        return NET_INVALID_SOCKET;
+    }
+    sockaddr_in address;
+    std::memcpy(&address, result->ai_addr, sizeof(address));
+    address.sin_port = htons(port);
+    freeaddrinfo(result);
+
+    NetSocketHandle handle = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (handle == NET_INVALID_SOCKET) {
+        std::cerr << "TCP socket could not be created!" << std::endl;
+        return NET_INVALID_SOCKET;
+    }
+    // Connect while still blocking, it is a local socket and only done once
+    if (connect(handle, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || !setNonBlocking(handle)) {
+        std::cerr << "Could not connect to " << host << ":" << port << "!" << std::endl;
+        closeSocket(handle);
+        return NET_INVALID_SOCKET;
+    }
+    setNoDelay(handle);
+    return handle;
+}
+
+int tcpSend(NetSocketHandle handle, const Uint8* data, int size) {
+    int sent = static_cast<int>(::send(handle, reinterpret_cast<const char*>(data), size, NET_SEND_FLAGS));
+    if (sent < 0) {
+        return NET_WOULD_BLOCK ? 0 : -1;
+    }
+    return sent;
+}
+
+int tcpReceive(NetSocketHandle handle, Uint8* buffer, int capacity) {
+    int received = static_cast<int>(recv(handle, reinterpret_cast<char*>(buffer), capacity, 0));
+    if (received == 0) {
+        return -1; // Orderly shutdown by the other side
+    }
+    if (received < 0) {
+        return NET_WOULD_BLOCK ? 0 : -1;
+    }
+    return received;
+}
+
+void closeTcp(NetSocketHandle handle) {
+    if (handle != NET_INVALID_SOCKET) {
+        closeSocket(handle);
+    }
+}
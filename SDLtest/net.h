@@ -0,0 +1,57 @@
+#pragma once
+#include <SDL.h>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef SOCKET NetSocketHandle;
+const NetSocketHandle NET_NO_SOCKET = INVALID_SOCKET;
+#else
+#include <netinet/in.h>
+typedef int NetSocketHandle;
+const NetSocketHandle NET_NO_SOCKET = -1;
+#endif
+
+// Something that moves datagrams between two game instances
+class Transport {
+public:
+    virtual ~Transport() {}
+    // Function to send one datagram to the peer (may be dropped)
+    virtual void send(const Uint8* data, int size) = 0;
+    // Function to fetch one waiting datagram, returns its size or 0 if nothing is waiting
+    virtual int receive(Uint8* buffer, int capacity) = 0;
+};
+
+// Non-blocking UDP socket talking to a single peer
+class UdpTransport : public Transport {
+public:
+    UdpTransport();
+    ~UdpTransport();
+
+    // Function to bind the local port; pass a peer to send first, or leave it empty to learn it from the first packet
+    bool open(Uint16 localPort, const char* peerHost, Uint16 peerPort);
+    void close();
+
+    void send(const Uint8* data, int size) override;
+    int receive(Uint8* buffer, int capacity) override;
+
+private:
+    NetSocketHandle handle;
+    sockaddr_in peer;
+    bool hasPeer;
+};
+
+// Function to start the platform socket library (no-op outside Windows)
+bool initializeNetwork();
+void shutdownNetwork();
+
+// Function to listen for TCP connections on a local port, returns NET_NO_SOCKET on failure
+NetSocketHandle openTcpListener(Uint16 port);
+// Function to take one waiting connection (non-blocking, no Nagle delay), NET_NO_SOCKET if none is waiting
+NetSocketHandle acceptTcpConnection(NetSocketHandle listener);
+// Function to connect to a TCP listener; the returned socket is non-blocking with Nagle disabled
+NetSocketHandle connectTcp(const char* host, Uint16 port);
+// Functions to move bytes over a non-blocking TCP socket: return the count moved, 0 if it would block, -1 once the connection is gone
+int tcpSend(NetSocketHandle handle, const Uint8* data, int size);
+int tcpReceive(NetSocketHandle handle, Uint8* buffer, int capacity);
+void closeTcp(NetSocketHandle handle);
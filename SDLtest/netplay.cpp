@@ -0,0 +1,340 @@
+#include "netplay.h"
+#include "ai.h"
+#include "input.h"
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+static const Uint32 NET_MAGIC = 0x474E4F50; // "PONG"
+static const int NET_HEADER_SIZE = 13;
+
+Uint32 LoopbackTransport::nowMs = 0;
+
+void saveSimState(SimState& state) {
+    saveGameState(state);
+}
+
+void loadSimState(const SimState& state) {
+    loadGameState(state);
+}
+
+Uint32 hashSimState(const SimState& state) {
+    // FNV-1a over the fields (not the struct bytes, which include padding)
+    Uint32 hash = 2166136261u;
+    auto mix = [&hash](const void* data, size_t size) {
+        const Uint8* bytes = static_cast<const Uint8*>(data);
+        for (size_t i = 0; i < size; ++i) {
+            hash = (hash ^ bytes[i]) * 16777619u;
+        }
+    };
+    mix(&state.ball.x, sizeof(float) * 2);
+    mix(&state.ball.dx, sizeof(float) * 3);
+    mix(&state.leftPaddle.y, sizeof(int));
+    mix(&state.rightPaddle.y, sizeof(int));
+    mix(&state.leftScore, sizeof(int));
+    mix(&state.rightScore, sizeof(int));
+    return hash;
+}
+
+// Paddle bounces heard while re-simulating, for the statistics
+static int rollbackPaddleHits = 0;
+
+// Function used while re-simulating: corrected ticks don't replay their sounds, paddle hits are only counted
+static void rollbackSound(GameSound sound) {
+    if (sound == GameSound::PADDLE) {
+        ++rollbackPaddleHits;
+    }
+}
+
+// Function to write/read little-endian 32-bit values in packets
+static void writeUint32(Uint8* out, Uint32 value) {
+    out[0] = static_cast<Uint8>(value);
+    out[1] = static_cast<Uint8>(value >> 8);
+    out[2] = static_cast<Uint8>(value >> 16);
+    out[3] = static_cast<Uint8>(value >> 24);
+}
+
+static Uint32 readUint32(const Uint8* in) {
+    return in[0] | (in[1] << 8) | (in[2] << 16) | (static_cast<Uint32>(in[3]) << 24);
+}
+
+// Function to run one tick of the simulation on the game globals
+static void simulateTick(RollbackSession& session, int tick) {
+    NetInput local = session.localInputs[tick & (NET_HISTORY - 1)];
+    NetInput remote = session.remoteInputs[tick & (NET_HISTORY - 1)];
+    NetInput left = session.localPlayer == 0 ? local : remote;
+    NetInput right = session.localPlayer == 0 ? remote : local;
+    movePaddle(leftPaddle, netInputUp(left), netInputDown(left));
+    movePaddle(rightPaddle, netInputUp(right), netInputDown(right));
+    update();
+}
+
+// Function to guess the remote input for a tick that hasn't been confirmed: repeat the last known one
+static NetInput predictRemoteInput(const RollbackSession& session) {
+    return session.lastRemoteTick < 0 ? 0 : session.remoteInputs[session.lastRemoteTick & (NET_HISTORY - 1)];
+}
+
+// Function to take in every waiting packet and note the oldest tick we guessed wrong
+static void receiveRemoteInputs(RollbackSession& session) {
+    Uint8 packet[NET_HEADER_SIZE + NET_MAX_INPUTS_PER_PACKET];
+    int size;
+    while ((size = session.transport->receive(packet, sizeof(packet))) > 0) {
+        if (size < NET_HEADER_SIZE || readUint32(packet) != NET_MAGIC) {
+            continue;
+        }
+        int newestTick = static_cast<int>(readUint32(packet + 4));
+        int ackTick = static_cast<int>(readUint32(packet + 8));
+        int count = packet[12];
+        if (size < NET_HEADER_SIZE + count) {
+            continue;
+        }
+        session.remoteAckTick = std::max(session.remoteAckTick, ackTick);
+
+        // Inputs cover newestTick - count + 1 .. newestTick; only extend the confirmed run
+        for (int i = 0; i < count; ++i) {
+            int tick = newestTick - count + 1 + i;
+            if (tick != session.lastRemoteTick + 1) {
+                continue;
+            }
+            NetInput input = packet[NET_HEADER_SIZE + i];
+            NetInput& slot = session.remoteInputs[tick & (NET_HISTORY - 1)];
+            if (tick < session.currentTick && slot != input &&
+                (session.firstMispredictedTick < 0 || tick < session.firstMispredictedTick)) {
+                session.firstMispredictedTick = tick;
+            }
+            slot = input;
+            session.lastRemoteTick = tick;
+        }
+    }
+}
+
+// Function to rewind to the oldest mispredicted tick and replay up to the present with corrected inputs
+static void rollBack(RollbackSession& session) {
+    int from = session.firstMispredictedTick;
+    session.firstMispredictedTick = -1;
+    if (from < 0) {
+        return;
+    }
+    Uint64 start = SDL_GetPerformanceCounter();
+    void (*soundHandler)(GameSound) = gameSoundHandler;
+    gameSoundHandler = rollbackSound;
+    rollbackPaddleHits = 0;
+
+    loadStateAt(session.states, from);
+    int scoreBefore = leftScore + rightScore;
+    NetInput prediction = predictRemoteInput(session);
+    for (int tick = from; tick < session.currentTick; ++tick) {
+        if (tick > session.lastRemoteTick) {
+            session.remoteInputs[tick & (NET_HISTORY - 1)] = prediction;
+        }
+        saveStateAt(session.states, tick);
+        simulateTick(session, tick);
+    }
+
+    gameSoundHandler = soundHandler;
+    if (leftScore + rightScore != scoreBefore) {
+        ++session.stats.goalRollbacks;
+    }
+    if (rollbackPaddleHits > 0) {
+        ++session.stats.paddleRollbacks;
+    }
+    int depth = session.currentTick - from;
+    ++session.stats.rollbacks;
+    session.stats.resimulatedTicks += depth;
+    session.stats.maxDepth = std::max(session.stats.maxDepth, depth);
+    session.stats.resimulateCounter += SDL_GetPerformanceCounter() - start;
+}
+
+// Function to send every local input the peer hasn't acknowledged yet
+static void sendLocalInputs(RollbackSession& session) {
+    int newestTick = session.currentTick - 1;
+    if (newestTick < 0) {
+        return;
+    }
+    int oldestTick = std::max(session.remoteAckTick + 1, newestTick - NET_MAX_INPUTS_PER_PACKET + 1);
+    int count = std::max(0, newestTick - oldestTick + 1);
+
+    Uint8 packet[NET_HEADER_SIZE + NET_MAX_INPUTS_PER_PACKET];
+    writeUint32(packet, NET_MAGIC);
+    writeUint32(packet + 4, static_cast<Uint32>(newestTick));
+    writeUint32(packet + 8, static_cast<Uint32>(session.lastRemoteTick));
+    packet[12] = static_cast<Uint8>(count);
+    for (int i = 0; i < count; ++i) {
+        packet[NET_HEADER_SIZE + i] = session.localInputs[(oldestTick + i) & (NET_HISTORY - 1)];
+    }
+    session.transport->send(packet, NET_HEADER_SIZE + count);
+}
+
+void startSession(RollbackSession& session, int localPlayer, Transport* transport) {
+    std::memset(&session, 0, sizeof(session));
+    session.localPlayer = localPlayer;
+    session.transport = transport;
+    session.lastRemoteTick = -1;
+    session.remoteAckTick = -1;
+    session.firstMispredictedTick = -1;
+    saveSimState(session.current);
+
+    // Re-simulation has to be instant, there's no time to wait out a serve pause
+    servePauseMs = 0;
+}
+
+bool advanceSession(RollbackSession& session, NetInput localInput) {
+    loadSimState(session.current);
+    receiveRemoteInputs(session);
+    rollBack(session);
+
+    // Don't run further ahead than rollback can undo, let the peer catch up instead
+    if (session.currentTick - session.lastRemoteTick > ROLLBACK_WINDOW) {
+        ++session.stats.stalls;
+        saveSimState(session.current);
+        sendLocalInputs(session);
+        return false;
+    }
+
+    int tick = session.currentTick;
+    session.localInputs[tick & (NET_HISTORY - 1)] = localInput;
+    if (tick > session.lastRemoteTick) {
+        session.remoteInputs[tick & (NET_HISTORY - 1)] = predictRemoteInput(session);
+    }
+    saveStateAt(session.states, tick);
+    simulateTick(session, tick);
+    ++session.currentTick;
+    ++session.stats.ticks;
+
+    saveSimState(session.current);
+    sendLocalInputs(session);
+    return true;
+}
+
+LoopbackTransport::LoopbackTransport(int delayMs, int jitterMs, int lossPercent, unsigned seed)
+    : peer(nullptr), delayMs(delayMs), jitterMs(jitterMs), lossPercent(lossPercent), rngState(seed != 0 ? seed : 1) {
+}
+
+void LoopbackTransport::connect(LoopbackTransport* other) {
+    peer = other;
+}
+
+void LoopbackTransport::send(const Uint8* data, int size) {
+    // xorshift for loss and jitter so test runs are reproducible
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    if (peer == nullptr || static_cast<int>(rngState % 100) < lossPercent || size > static_cast<int>(sizeof(Datagram::data))) {
+        return;
+    }
+    Datagram datagram;
+    int jitter = jitterMs > 0 ? static_cast<int>((rngState >> 8) % (2 * jitterMs + 1)) - jitterMs : 0;
+    datagram.deliverAt = nowMs + std::max(0, delayMs + jitter);
+    datagram.size = size;
+    std::memcpy(datagram.data, data, size);
+    peer->inbox.push_back(datagram);
+}
+
+int LoopbackTransport::receive(Uint8* buffer, int capacity) {
+    // Jitter can reorder packets, so deliver any that are due rather than only the front one
+    for (auto it = inbox.begin(); it != inbox.end(); ++it) {
+        if (static_cast<Sint32>(nowMs - it->deliverAt) >= 0) {
+            int size = std::min(capacity, it->size);
+            std::memcpy(buffer, it->data, size);
+            inbox.erase(it);
+            return size;
+        }
+    }
+    return 0;
+}
+
+// Function to get a session's state at the start of a tick it has already reached
+static const SimState& sessionStateAt(const RollbackSession& session, int tick) {
+    return tick == session.currentTick ? session.current : stateAt(session.states, tick);
+}
+
+// Function to print one session's statistics
+static void printRollbackStats(const char* name, const RollbackStats& stats) {
+    std::cout << std::setw(6) << name << std::setw(10) << stats.ticks << std::setw(11) << stats.rollbacks
+        << std::setw(11) << std::fixed << std::setprecision(2)
+        << (stats.rollbacks ? static_cast<double>(stats.resimulatedTicks) / stats.rollbacks : 0.0)
+        << std::setw(11) << stats.maxDepth << std::setw(9) << stats.stalls
+        << std::setw(14) << (stats.rollbacks ? stats.resimulateCounter * 1000000.0 / SDL_GetPerformanceFrequency() / stats.rollbacks : 0.0) << std::endl;
+}
+
+bool runLoopbackTest(int ticks, int rttMs, int jitterMs, int lossPercent) {
+    resetPaddles();
+    leftScore = 0;
+    rightScore = 0;
+    servePauseMs = 0;
+    resetBall(true);
+
+    LoopbackTransport leftLink(rttMs / 2, jitterMs, lossPercent, 1);
+    LoopbackTransport rightLink(rttMs / 2, jitterMs, lossPercent, 2);
+    leftLink.connect(&rightLink);
+    rightLink.connect(&leftLink);
+
+    // Sessions are large (full state history), keep them off the stack; static storage also
+    // gives the state ring its alignment without aligned new
+    static RollbackSession sessions[2];
+    startSession(sessions[0], 0, &leftLink);
+    startSession(sessions[1], 1, &rightLink);
+
+    // Mismatched AIs so goals are scored, and rollbacks have to re-simulate across them
+    AiController ais[2];
+    initAi(ais[0], 12, 120.0f, 11);
+    initAi(ais[1], 12, 150.0f, 12);
+
+    const unsigned TWITCH_PERCENT = 10;    // ticks out of 100 where a side presses a random key instead
+    unsigned twitchState = 13;
+
+    bool inSync = true;
+    int checkedTick = -1;
+    for (int step = 0; step < ticks && inSync; ++step) {
+        LoopbackTransport::nowMs = step * TICK_MS;
+
+        // Each side's AI plays from its own (possibly predicted) view of the game
+        for (int side = 0; side < 2; ++side) {
+            const SimState& view = sessions[side].current;
+            bool up, down;
+            aiDecide(ais[side], view.ball, side == 0 ? view.leftPaddle : view.rightPaddle, side == 0, up, down);
+            NetInput input = static_cast<NetInput>((up ? NET_INPUT_UP : 0) | (down ? NET_INPUT_DOWN : 0));
+            // Now and then a stray key press, so inputs keep changing (and predictions keep failing) right up to each goal
+            twitchState ^= twitchState << 13;
+            twitchState ^= twitchState >> 17;
+            twitchState ^= twitchState << 5;
+            if (twitchState % 100 < TWITCH_PERCENT) {
+                input = static_cast<NetInput>((twitchState >> 8) % 3);
+            }
+            advanceSession(sessions[side], input);
+        }
+
+        // Once both sides have every input before a tick, their states at that tick must be identical
+        int syncTick = std::min(sessions[0].lastRemoteTick, sessions[1].lastRemoteTick) + 1;
+        syncTick = std::min(syncTick, std::min(sessions[0].currentTick, sessions[1].currentTick));
+        if (syncTick > checkedTick) {
+            checkedTick = syncTick;
+            Uint32 leftHash = hashSimState(sessionStateAt(sessions[0], syncTick));
+            Uint32 rightHash = hashSimState(sessionStateAt(sessions[1], syncTick));
+            if (leftHash != rightHash) {
+                std::cerr << "Desync at tick " << syncTick << ": " << std::hex << leftHash << " != " << rightHash << std::dec << std::endl;
+                inSync = false;
+            }
+        }
+    }
+
+    std::cout << "Rollback loopback: " << ticks << " ticks, " << rttMs << " ms RTT, +/-" << jitterMs << " ms jitter, "
+        << lossPercent << "% loss, verified in sync through tick " << checkedTick << std::endl;
+    std::cout << std::setw(6) << "side" << std::setw(10) << "ticks" << std::setw(11) << "rollbacks" << std::setw(11) << "avg depth"
+        << std::setw(11) << "max depth" << std::setw(9) << "stalls" << std::setw(14) << "us/rollback" << std::endl;
+    printRollbackStats("left", sessions[0].stats);
+    printRollbackStats("right", sessions[1].stats);
+    std::cout << "Final score " << sessions[0].current.leftScore << " - " << sessions[0].current.rightScore
+        << (inSync ? ", sessions agree" : ", SESSIONS DIVERGED") << std::endl;
+
+    Uint64 goalRollbacks = sessions[0].stats.goalRollbacks + sessions[1].stats.goalRollbacks;
+    Uint64 paddleRollbacks = sessions[0].stats.paddleRollbacks + sessions[1].stats.paddleRollbacks;
+    std::cout << goalRollbacks << " rollbacks re-simulated a goal, " << paddleRollbacks << " a paddle bounce" << std::endl;
+    const SimState& finalState = sessions[0].current;
+    if (finalState.leftScore == 0 || finalState.rightScore == 0 || goalRollbacks == 0 || paddleRollbacks == 0) {
+        std::cerr << "The run didn't roll back across goals for both sides and paddle bounces, too short to trust" << std::endl;
+        return false;
+    }
+    return inSync;
+}
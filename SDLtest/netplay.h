@@ -0,0 +1,95 @@
+#pragma once
+#include "game.h"
+#include "net.h"
+#include "statering.h"
+#include <deque>
+
+// Ticks of input/state history kept for rollback (the state ring's size)
+const int NET_HISTORY = STATE_RING_SIZE;
+// How far the local simulation may run ahead of the last confirmed remote input (200 ms)
+const int ROLLBACK_WINDOW = 20;
+// Most inputs repeated in one packet, so a lost packet is covered by the next one
+const int NET_MAX_INPUTS_PER_PACKET = 64;
+
+// One player's controls for a tick: bit 0 = up, bit 1 = down
+typedef Uint8 NetInput;
+const NetInput NET_INPUT_UP = 1;
+const NetInput NET_INPUT_DOWN = 2;
+
+// Everything update()/movePaddle() read or write, so a tick can be undone
+typedef GameState SimState;
+
+// Function to copy the game globals into a snapshot
+void saveSimState(SimState& state);
+// Function to copy a snapshot back into the game globals
+void loadSimState(const SimState& state);
+// Function to hash a snapshot for desync checks
+Uint32 hashSimState(const SimState& state);
+
+// Counters describing how much re-simulation the session did
+struct RollbackStats {
+    Uint64 ticks;
+    Uint64 rollbacks;
+    Uint64 resimulatedTicks;
+    int maxDepth;
+    Uint64 stalls;
+    Uint64 goalRollbacks;       // rollbacks whose re-simulation crossed a goal (score change and serve reset)
+    Uint64 paddleRollbacks;     // rollbacks whose re-simulation bounced the ball off a paddle
+    Uint64 resimulateCounter;   // SDL performance counter ticks spent re-simulating
+};
+
+// One side of a two-player rollback match
+struct RollbackSession {
+    int localPlayer;            // 0 = left paddle, 1 = right paddle
+    Transport* transport;
+    int currentTick;            // next tick to simulate
+    int lastRemoteTick;         // newest tick with a confirmed remote input (all older ones confirmed too)
+    int remoteAckTick;          // newest of our ticks the peer has confirmed
+    int firstMispredictedTick;  // oldest tick simulated with a wrong guess, -1 if none
+    NetInput localInputs[NET_HISTORY];
+    NetInput remoteInputs[NET_HISTORY];  // confirmed up to lastRemoteTick, predicted after
+    StateRing states;                    // state at the start of each tick
+    SimState current;
+    RollbackStats stats;
+};
+
+// Function to reset a session to tick 0 with the current game globals as the starting state
+void startSession(RollbackSession& session, int localPlayer, Transport* transport);
+
+// Function to run one tick with this side's input: receives, rolls back if a guess was wrong,
+// simulates and sends. Returns false (and simulates nothing) when too far ahead of the peer.
+bool advanceSession(RollbackSession& session, NetInput localInput);
+
+// Function to convert a NetInput to the bools movePaddle() takes
+inline bool netInputUp(NetInput input) { return (input & NET_INPUT_UP) != 0; }
+inline bool netInputDown(NetInput input) { return (input & NET_INPUT_DOWN) != 0; }
+
+// In-memory transport with simulated one-way delay, jitter and loss, for testing without a network
+class LoopbackTransport : public Transport {
+public:
+    LoopbackTransport(int delayMs, int jitterMs, int lossPercent, unsigned seed);
+    // Function to pair two loopback transports so each receives what the other sends
+    void connect(LoopbackTransport* other);
+
+    void send(const Uint8* data, int size) override;
+    int receive(Uint8* buffer, int capacity) override;
+
+    // Virtual clock shared by every loopback transport, advanced by the test driver
+    static Uint32 nowMs;
+
+private:
+    struct Datagram {
+        Uint32 deliverAt;
+        int size;
+        Uint8 data[1 + 3 * 4 + NET_MAX_INPUTS_PER_PACKET];
+    };
+    LoopbackTransport* peer;
+    std::deque<Datagram> inbox;
+    int delayMs, jitterMs, lossPercent;
+    unsigned rngState;
+};
+
+// Function to run two sessions against each other over a LoopbackTransport, driven by AI input.
+// Prints rollback statistics and returns false if the two simulations ever disagree, or if the run
+// never re-simulated what is most likely to desync: goals for both sides and paddle bounces.
+bool runLoopbackTest(int ticks, int rttMs, int jitterMs, int lossPercent);
@@ -0,0 +1,166 @@
+#include "perfhud.h"
+#include "game.h"
+#include "spritebatch.h"
+#include <cstdio>
+
+// Lines of text above the graph
+static const int HUD_LINES = 5;
+static const int HUD_PADDING = 6;
+static const int HUD_MARGIN = 10;
+// Graph bars turn yellow past one 60 Hz frame and red past two
+static const float HUD_SMOOTH_MS = 1000.0f / 60.0f;
+
+static bool visible = false;
+
+// Frame times for the graph, oldest at historyHead
+static float frameHistory[HUD_HISTORY];
+static int historyHead = 0;
+static Uint64 frameStart = 0;
+
+// The frame in progress
+static Uint64 phaseCounters[static_cast<int>(HudPhase::COUNT)];
+static int counters[static_cast<int>(HudCounter::COUNT)];
+
+// Totals since the readouts were last refreshed
+static Uint64 windowStart = 0;
+static int windowFrames = 0;
+static Uint64 windowPhases[static_cast<int>(HudPhase::COUNT)];
+static int windowTextures = 0;
+
+// What the text shows until the next refresh
+struct HudReadout {
+    float fps;
+    float frameMs;
+    float phaseMs[static_cast<int>(HudPhase::COUNT)];
+    int drawCalls;
+    int particles;
+    int textures;
+    int newTextures;
+    float hudMs;
+};
+static HudReadout readout;
+static float hudMs = 0.0f;
+// The readout as text, formatted once per refresh rather than every frame
+static char lines[HUD_LINES][64];
+
+// Function to convert performance counter ticks to milliseconds
+static float counterToMs(Uint64 ticks) {
+    return static_cast<float>(ticks) * 1000.0f / static_cast<float>(SDL_GetPerformanceFrequency());
+}
+
+// Function to turn the readout into the lines drawHud() shows
+static void formatReadout() {
+    std::snprintf(lines[0], sizeof(lines[0]), "%.0f fps  %.2f ms", readout.fps, readout.frameMs);
+    std::snprintf(lines[1], sizeof(lines[1]), "events %.2f  sim %.2f ms",
+        readout.phaseMs[static_cast<int>(HudPhase::EVENTS)], readout.phaseMs[static_cast<int>(HudPhase::SIMULATE)]);
+    std::snprintf(lines[2], sizeof(lines[2]), "render %.2f  present %.2f ms",
+        readout.phaseMs[static_cast<int>(HudPhase::RENDER)], readout.phaseMs[static_cast<int>(HudPhase::PRESENT)]);
+    std::snprintf(lines[3], sizeof(lines[3]), "draws %d  particles %d", readout.drawCalls, readout.particles);
+    std::snprintf(lines[4], sizeof(lines[4]), "textures %d (+%d)  hud %.3f ms", readout.textures, readout.newTextures, readout.hudMs);
+}
+
+void toggleHud() {
+    visible = !visible;
+}
+
+bool hudVisible() {
+    return visible;
+}
+
+void hudBeginFrame() {
+    Uint64 now = SDL_GetPerformanceCounter();
+    if (frameStart != 0) {
+        frameHistory[historyHead] = counterToMs(now - frameStart);
+        historyHead = (historyHead + 1) % HUD_HISTORY;
+        ++windowFrames;
+        for (int i = 0; i < static_cast<int>(HudPhase::COUNT); ++i) {
+            windowPhases[i] += phaseCounters[i];
+        }
+        readout.drawCalls = counters[static_cast<int>(HudCounter::DRAW_CALLS)];
+        readout.particles = counters[static_cast<int>(HudCounter::PARTICLES)];
+    }
+    else {
+        windowStart = now;
+    }
+    frameStart = now;
+    for (Uint64& phase : phaseCounters) {
+        phase = 0;
+    }
+    counters[static_cast<int>(HudCounter::DRAW_CALLS)] = 0;
+    counters[static_cast<int>(HudCounter::PARTICLES)] = 0;
+
+    // Averages over the refresh window read steadier than any single frame
+    Uint64 elapsed = now - windowStart;
+    if (windowFrames > 0 && counterToMs(elapsed) >= HUD_REFRESH_MS) {
+        readout.fps = windowFrames * 1000.0f / counterToMs(elapsed);
+        readout.frameMs = counterToMs(elapsed) / windowFrames;
+        for (int i = 0; i < static_cast<int>(HudPhase::COUNT); ++i) {
+            readout.phaseMs[i] = counterToMs(windowPhases[i]) / windowFrames;
+            windowPhases[i] = 0;
+        }
+        readout.textures = counters[static_cast<int>(HudCounter::TEXTURES)];
+        readout.newTextures = readout.textures - windowTextures;
+        windowTextures = readout.textures;
+        readout.hudMs = hudMs;
+        windowStart = now;
+        windowFrames = 0;
+        formatReadout();
+    }
+}
+
+Uint64 hudPhaseEnd(HudPhase phase, Uint64 start) {
+    Uint64 now = SDL_GetPerformanceCounter();
+    phaseCounters[static_cast<int>(phase)] += now - start;
+    return now;
+}
+
+void hudCount(HudCounter counter, int amount) {
+    counters[static_cast<int>(counter)] += amount;
+}
+
+SDL_Rect hudBounds() {
+    int width = HUD_HISTORY * 2 + 2 * HUD_PADDING;
+    int height = HUD_LINES * atlasTextHeight(AtlasFont::HUD) + HUD_GRAPH_HEIGHT + 3 * HUD_PADDING;
+    // Bottom left, clear of the menu entries and above the replay progress bar
+    return { HUD_MARGIN, SCREEN_HEIGHT - height - HUD_MARGIN, width, height };
+}
+
+void drawHud() {
+    if (!visible) {
+        return;
+    }
+
+    SDL_Rect panel = hudBounds();
+    batchFillRect(panel, { 0, 0, 0, 170 });
+
+    // Text from the cached glyphs
+    SDL_Color textColor = { 255, 255, 255, 255 };
+    int lineHeight = atlasTextHeight(AtlasFont::HUD);
+    for (int i = 0; i < HUD_LINES; ++i) {
+        batchText(AtlasFont::HUD, lines[i], panel.x + HUD_PADDING, panel.y + HUD_PADDING + i * lineHeight, textColor);
+    }
+
+    // Frame-time graph, newest frame on the right, with a line at 60 Hz
+    int graphLeft = panel.x + HUD_PADDING;
+    int graphBottom = panel.y + panel.h - HUD_PADDING;
+    for (int i = 0; i < HUD_HISTORY; ++i) {
+        float ms = frameHistory[(historyHead + i) % HUD_HISTORY];
+        int height = static_cast<int>(ms / HUD_GRAPH_MS * HUD_GRAPH_HEIGHT + 0.5f);
+        if (height > HUD_GRAPH_HEIGHT) {
+            height = HUD_GRAPH_HEIGHT;
+        }
+        if (height < 1) {
+            height = 1;
+        }
+        SDL_Color color = ms <= HUD_SMOOTH_MS ? SDL_Color{ 80, 220, 80, 255 } :
+            ms <= 2.0f * HUD_SMOOTH_MS ? SDL_Color{ 240, 200, 40, 255 } : SDL_Color{ 240, 60, 40, 255 };
+        batchFillRect({ graphLeft + i * 2, graphBottom - height, 2, height }, color);
+    }
+    int smoothHeight = static_cast<int>(HUD_SMOOTH_MS / HUD_GRAPH_MS * HUD_GRAPH_HEIGHT + 0.5f);
+    batchFillRect({ graphLeft, graphBottom - smoothHeight, HUD_HISTORY * 2, 1 }, { 255, 255, 255, 120 });
+}
+
+void hudOverlayEnd(Uint64 start) {
+    float ms = counterToMs(SDL_GetPerformanceCounter() - start);
+    hudMs = hudMs * 0.9f + ms * 0.1f;
+}
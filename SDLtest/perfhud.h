@@ -0,0 +1,50 @@
+#pragma once
+#include <SDL.h>
+
+// Frames shown in the frame-time graph, one 2 px bar each
+const int HUD_HISTORY = 120;
+// Graph height in pixels and the frame time that fills it
+const int HUD_GRAPH_HEIGHT = 48;
+const float HUD_GRAPH_MS = 33.3f;
+// How often the text readouts are refreshed, averaged over the frames in between
+const Uint32 HUD_REFRESH_MS = 500;
+
+// Parts of a main loop iteration the overlay times separately
+enum class HudPhase {
+    EVENTS,     // SDL_PollEvent and input handling
+    SIMULATE,   // game ticks
+    RENDER,     // render() or renderMenu(), present included
+    PRESENT,    // SDL_RenderPresent or the dirty-rect update
+    COUNT
+};
+
+// Things the overlay counts: draw calls and particles per frame, textures since startup
+enum class HudCounter {
+    DRAW_CALLS,
+    PARTICLES,
+    TEXTURES,
+    COUNT
+};
+
+// Function to show or hide the overlay (F3, or --hud to start with it shown)
+void toggleHud();
+bool hudVisible();
+
+// Function to close the previous frame's numbers and start a new frame; call once at the top of the main loop
+void hudBeginFrame();
+
+// Function to add the time since start to a phase of this frame, returns the current counter for chaining
+Uint64 hudPhaseEnd(HudPhase phase, Uint64 start);
+
+// Function to add to a counter
+void hudCount(HudCounter counter, int amount = 1);
+
+// Function to get the screen area the overlay covers
+SDL_Rect hudBounds();
+
+// Function to queue the overlay into the sprite batch; the caller flushes it with the rest of the frame
+void drawHud();
+
+// Function to record what the overlay cost this frame, from start (taken before drawHud()) until its
+// quads were flushed; shown on the overlay's own readout
+void hudOverlayEnd(Uint64 start);
@@ -0,0 +1,400 @@
+#include "raster.h"
+#include "game.h"
+#include "trace.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define RASTER_SSE2 1
+#endif
+
+// Worker pool: every thread pulls tiles off a shared counter until the frame is done
+static std::vector<std::thread> workers;
+static std::mutex poolMutex;
+static std::condition_variable workReady;
+static std::condition_variable workDone;
+static RasterFrame* job = nullptr;
+static unsigned generation = 0;
+static int busyWorkers = 0;
+static bool stopping = false;
+static std::atomic<int> nextTile(0);
+
+static Uint32 packColor(SDL_Color color) {
+    return (static_cast<Uint32>(color.a) << 24) | (static_cast<Uint32>(color.r) << 16) | (static_cast<Uint32>(color.g) << 8) | color.b;
+}
+
+// Function to map game x/y to frame pixels
+static int frameX(const RasterFrame& frame, int x) {
+    return static_cast<int>(x * frame.scaleX + 0.5f);
+}
+
+static int frameY(const RasterFrame& frame, int y) {
+    return static_cast<int>(y * frame.scaleY + 0.5f);
+}
+
+// Function to map a game rectangle to frame pixels, at least one pixel across
+static SDL_Rect frameRect(const RasterFrame& frame, int x, int y, int w, int h) {
+    int x0 = frameX(frame, x);
+    int y0 = frameY(frame, y);
+    int x1 = frameX(frame, x + w);
+    int y1 = frameY(frame, y + h);
+    return { x0, y0, x1 > x0 ? x1 - x0 : 1, y1 > y0 ? y1 - y0 : 1 };
+}
+
+void initRasterFrame(RasterFrame& frame, int width, int height) {
+    frame.width = width;
+    frame.height = height;
+    frame.scaleX = static_cast<float>(width) / SCREEN_WIDTH;
+    frame.scaleY = static_cast<float>(height) / SCREEN_HEIGHT;
+    frame.color = { 0, 0, 0, 255 };
+    frame.pixels.assign(static_cast<size_t>(width) * height, 0);
+    frame.commands.clear();
+    frame.tilesX = (width + RASTER_TILE_WIDTH - 1) / RASTER_TILE_WIDTH;
+    frame.tilesY = (height + RASTER_TILE_HEIGHT - 1) / RASTER_TILE_HEIGHT;
+    frame.bins.assign(frame.tilesX * frame.tilesY, std::vector<int>());
+}
+
+void rasterSetColor(RasterFrame& frame, Uint8 r, Uint8 g, Uint8 b, Uint8 a) {
+    frame.color = { r, g, b, a };
+}
+
+// Function to record a command whose rect is already in frame pixels, dropping it if it is off the frame
+static void addCommand(RasterFrame& frame, const RasterCommand& command) {
+    SDL_Rect bounds = { 0, 0, frame.width, frame.height };
+    if (SDL_HasIntersection(&command.rect, &bounds)) {
+        frame.commands.push_back(command);
+    }
+}
+
+void rasterClear(RasterFrame& frame) {
+    RasterCommand command = { RasterOp::FILL, 0, frame.color, { 0, 0, frame.width, frame.height }, {} };
+    addCommand(frame, command);
+}
+
+void rasterFillRect(RasterFrame& frame, const SDL_Rect& rect) {
+    if (rect.w <= 0 || rect.h <= 0) {
+        return;
+    }
+    RasterCommand command = { RasterOp::FILL, 0, frame.color, frameRect(frame, rect.x, rect.y, rect.w, rect.h), {} };
+    addCommand(frame, command);
+}
+
+void rasterDrawRect(RasterFrame& frame, const SDL_Rect& rect) {
+    // One-pixel outline: top and bottom rows, then the columns between them
+    if (rect.w <= 0 || rect.h <= 0) {
+        return;
+    }
+    rasterFillRect(frame, { rect.x, rect.y, rect.w, 1 });
+    if (rect.h > 1) {
+        rasterFillRect(frame, { rect.x, rect.y + rect.h - 1, rect.w, 1 });
+    }
+    if (rect.h > 2) {
+        rasterFillRect(frame, { rect.x, rect.y + 1, 1, rect.h - 2 });
+        rasterFillRect(frame, { rect.x + rect.w - 1, rect.y + 1, 1, rect.h - 2 });
+    }
+}
+
+void rasterDrawLine(RasterFrame& frame, int x1, int y1, int x2, int y2) {
+    int left = x1 < x2 ? x1 : x2;
+    int top = y1 < y2 ? y1 : y2;
+    int width = (x1 < x2 ? x2 - x1 : x1 - x2) + 1;
+    int height = (y1 < y2 ? y2 - y1 : y1 - y2) + 1;
+    RasterCommand command = { RasterOp::LINE, 0, frame.color, frameRect(frame, left, top, width, height), { x1, y1, x2, y2 } };
+    addCommand(frame, command);
+}
+
+void rasterDrawPoint(RasterFrame& frame, int x, int y) {
+    rasterFillRect(frame, { x, y, 1, 1 });
+}
+
+void rasterSprite(RasterFrame& frame, const AtlasSprite& sprite, const SDL_Rect& dst, SDL_Color color) {
+    if (dst.w <= 0 || dst.h <= 0) {
+        return;
+    }
+    SDL_Rect rect = frameRect(frame, dst.x, dst.y, dst.w, dst.h);
+    // Opaque solid-colour quads are plain fills
+    const AtlasSprite& white = atlasWhiteSprite();
+    if (color.a == 255 && sprite.page == white.page && sprite.rect.x == white.rect.x && sprite.rect.y == white.rect.y) {
+        RasterCommand command = { RasterOp::FILL, 0, color, rect, {} };
+        addCommand(frame, command);
+        return;
+    }
+    RasterCommand command = { RasterOp::SPRITE, static_cast<Uint8>(sprite.page), color, rect, sprite.rect };
+    addCommand(frame, command);
+}
+
+// Function to set count pixels to one value, four at a time where SSE2 is available
+static void fillSpan(Uint32* dst, int count, Uint32 value) {
+    int i = 0;
+#ifdef RASTER_SSE2
+    __m128i fill = _mm_set1_epi32(static_cast<int>(value));
+    for (; i + 16 <= count; i += 16) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), fill);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 4), fill);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 8), fill);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 12), fill);
+    }
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), fill);
+    }
+#endif
+    for (; i < count; ++i) {
+        dst[i] = value;
+    }
+}
+
+static void fillClipped(RasterFrame& frame, const SDL_Rect& rect, const SDL_Rect& clip, Uint32 value) {
+    SDL_Rect area;
+    if (!SDL_IntersectRect(&rect, &clip, &area)) {
+        return;
+    }
+    Uint32* row = frame.pixels.data() + static_cast<size_t>(area.y) * frame.width + area.x;
+    for (int y = 0; y < area.h; ++y, row += frame.width) {
+        fillSpan(row, area.w, value);
+    }
+}
+
+// Function to stamp every pixel of a line (Bresenham, both ends included) that falls in the tile
+static void drawLineClipped(RasterFrame& frame, const RasterCommand& command, const SDL_Rect& clip) {
+    Uint32 value = packColor(command.color);
+    int x = command.source.x, y = command.source.y;
+    int x2 = command.source.w, y2 = command.source.h;
+    int dx = std::abs(x2 - x), sx = x < x2 ? 1 : -1;
+    int dy = -std::abs(y2 - y), sy = y < y2 ? 1 : -1;
+    int error = dx + dy;
+    while (true) {
+        fillClipped(frame, frameRect(frame, x, y, 1, 1), clip, value);
+        if (x == x2 && y == y2) {
+            break;
+        }
+        int twice = 2 * error;
+        if (twice >= dy) {
+            error += dy;
+            x += sx;
+        }
+        if (twice <= dx) {
+            error += dx;
+            y += sy;
+        }
+    }
+}
+
+// Function to divide a product of two 8-bit values by 255, rounded, without a division
+static inline int divide255(int value) {
+    value += 128;
+    return (value + (value >> 8)) >> 8;
+}
+
+// Function to draw a tinted atlas quad with nearest sampling and SDL_BLENDMODE_BLEND
+static void drawSpriteClipped(RasterFrame& frame, const RasterCommand& command, const SDL_Rect& clip) {
+    SDL_Rect area;
+    const SDL_Surface* surface = atlasPageSurface(command.page);
+    if (surface == nullptr || !SDL_IntersectRect(&command.rect, &clip, &area)) {
+        return;
+    }
+    const SDL_Rect& dst = command.rect;
+    const SDL_Rect& src = command.source;
+    const SDL_Color& tint = command.color;
+    // Texel column of the first pixel as quotient and remainder, stepped without dividing per pixel
+    int startNumerator = (area.x - dst.x) * src.w;
+    int startColumn = startNumerator / dst.w;
+    int startRemainder = startNumerator % dst.w;
+    for (int y = area.y; y < area.y + area.h; ++y) {
+        int v = src.y + (y - dst.y) * src.h / dst.h;
+        const Uint8* texels = static_cast<const Uint8*>(surface->pixels) + v * surface->pitch + 4 * src.x;   // RGBA32 bytes
+        Uint32* out = frame.pixels.data() + static_cast<size_t>(y) * frame.width + area.x;
+        int column = startColumn;
+        int remainder = startRemainder;
+        for (int i = 0; i < area.w; ++i) {
+            const Uint8* texel = texels + 4 * column;
+            remainder += src.w;
+            while (remainder >= dst.w) {
+                remainder -= dst.w;
+                ++column;
+            }
+            int alpha = divide255(texel[3] * tint.a);
+            if (alpha == 0) {
+                continue;
+            }
+            int r = divide255(texel[0] * tint.r);
+            int g = divide255(texel[1] * tint.g);
+            int b = divide255(texel[2] * tint.b);
+            if (alpha == 255) {
+                out[i] = 0xFF000000u | (r << 16) | (g << 8) | b;
+                continue;
+            }
+            Uint32 d = out[i];
+            int inverse = 255 - alpha;
+            int dr = divide255(r * alpha + ((d >> 16) & 0xFF) * inverse);
+            int dg = divide255(g * alpha + ((d >> 8) & 0xFF) * inverse);
+            int db = divide255(b * alpha + (d & 0xFF) * inverse);
+            int da = alpha + divide255((d >> 24) * inverse);
+            out[i] = (static_cast<Uint32>(da) << 24) | (dr << 16) | (dg << 8) | db;
+        }
+    }
+}
+
+static void drawTile(RasterFrame& frame, int tile) {
+    int tileX = (tile % frame.tilesX) * RASTER_TILE_WIDTH;
+    int tileY = (tile / frame.tilesX) * RASTER_TILE_HEIGHT;
+    SDL_Rect clip = { tileX, tileY, RASTER_TILE_WIDTH, RASTER_TILE_HEIGHT };
+    if (clip.x + clip.w > frame.width) {
+        clip.w = frame.width - clip.x;
+    }
+    if (clip.y + clip.h > frame.height) {
+        clip.h = frame.height - clip.y;
+    }
+    for (int index : frame.bins[tile]) {
+        const RasterCommand& command = frame.commands[index];
+        switch (command.op) {
+        case RasterOp::FILL:
+            fillClipped(frame, command.rect, clip, packColor(command.color));
+            break;
+        case RasterOp::LINE:
+            drawLineClipped(frame, command, clip);
+            break;
+        case RasterOp::SPRITE:
+            drawSpriteClipped(frame, command, clip);
+            break;
+        }
+    }
+}
+
+static void drawTiles(RasterFrame& frame) {
+    int count = frame.tilesX * frame.tilesY;
+    for (int tile = nextTile++; tile < count; tile = nextTile++) {
+        drawTile(frame, tile);
+    }
+}
+
+// Function run by each worker; seen is the generation when it was started, so a frame handed
+// out before the thread first takes the lock still counts as new
+static void workerLoop(unsigned seen) {
+    traceThreadName("raster worker");
+    std::unique_lock<std::mutex> lock(poolMutex);
+    while (true) {
+        workReady.wait(lock, [&seen] { return stopping || generation != seen; });
+        if (stopping) {
+            return;
+        }
+        seen = generation;
+        RasterFrame* frame = job;
+        lock.unlock();
+        {
+            TRACE_SCOPE("raster tiles");
+            drawTiles(*frame);
+        }
+        lock.lock();
+        if (--busyWorkers == 0) {
+            workDone.notify_one();
+        }
+    }
+}
+
+void rasterizeFrame(RasterFrame& frame) {
+    TRACE_SCOPE("rasterizeFrame");
+    // Bin each command into every tile its bounds touch
+    for (std::vector<int>& bin : frame.bins) {
+        bin.clear();
+    }
+    for (int i = 0; i < static_cast<int>(frame.commands.size()); ++i) {
+        const SDL_Rect& rect = frame.commands[i].rect;
+        int x0 = (rect.x < 0 ? 0 : rect.x) / RASTER_TILE_WIDTH;
+        int y0 = (rect.y < 0 ? 0 : rect.y) / RASTER_TILE_HEIGHT;
+        int x1 = (rect.x + rect.w > frame.width ? frame.width : rect.x + rect.w) - 1;
+        int y1 = (rect.y + rect.h > frame.height ? frame.height : rect.y + rect.h) - 1;
+        for (int ty = y0; ty <= y1 / RASTER_TILE_HEIGHT; ++ty) {
+            for (int tx = x0; tx <= x1 / RASTER_TILE_WIDTH; ++tx) {
+                frame.bins[ty * frame.tilesX + tx].push_back(i);
+            }
+        }
+    }
+
+    nextTile = 0;
+    if (workers.empty()) {
+        drawTiles(frame);
+    }
+    else {
+        {
+            std::lock_guard<std::mutex> lock(poolMutex);
+            job = &frame;
+            busyWorkers = static_cast<int>(workers.size());
+            ++generation;
+        }
+        workReady.notify_all();
+        drawTiles(frame);
+        std::unique_lock<std::mutex> lock(poolMutex);
+        workDone.wait(lock, [] { return busyWorkers == 0; });
+        job = nullptr;
+    }
+    frame.commands.clear();
+}
+
+bool saveRasterFrame(const RasterFrame& frame, const char* path) {
+    SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormatFrom(const_cast<Uint32*>(frame.pixels.data()), frame.width, frame.height,
+        32, frame.width * 4, SDL_PIXELFORMAT_ARGB8888);
+    if (surface == nullptr) {
+        std::cerr << "Unable to wrap the frame in a surface! SDL Error: " << SDL_GetError() << std::endl;
+        return false;
+    }
+    bool saved = SDL_SaveBMP(surface, path) == 0;
+    if (!saved) {
+        std::cerr << "Unable to save " << path << "! SDL Error: " << SDL_GetError() << std::endl;
+    }
+    SDL_FreeSurface(surface);
+    return saved;
+}
+
+int compareRasterFrame(const RasterFrame& frame, SDL_Renderer* renderer) {
+    std::vector<Uint32> expected(frame.pixels.size());
+    if (SDL_RenderReadPixels(renderer, NULL, SDL_PIXELFORMAT_ARGB8888, expected.data(), frame.width * 4) != 0) {
+        std::cerr << "Unable to read back the renderer! SDL Error: " << SDL_GetError() << std::endl;
+        return -1;
+    }
+    int different = 0;
+    for (size_t i = 0; i < expected.size(); ++i) {
+        // Alpha is left out: the window's pixels have none
+        for (int shift = 0; shift < 24; shift += 8) {
+            int a = (frame.pixels[i] >> shift) & 0xFF;
+            int b = (expected[i] >> shift) & 0xFF;
+            if (a - b > 1 || b - a > 1) {
+                ++different;
+                break;
+            }
+        }
+    }
+    return different;
+}
+
+void startRasterThreads(int threads) {
+    stopRasterThreads();
+    if (threads <= 0) {
+        threads = static_cast<int>(std::thread::hardware_concurrency());
+    }
+    // The calling thread draws tiles too
+    for (int i = 1; i < threads; ++i) {
+        workers.emplace_back(workerLoop, generation);
+    }
+}
+
+void stopRasterThreads() {
+    {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        stopping = true;
+    }
+    workReady.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+    stopping = false;
+}
+
+int rasterThreadCount() {
+    return static_cast<int>(workers.size()) + 1;
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include "atlas.h"
+#include <vector>
+
+// Tile size in frame pixels. 64 KB of pixels stays in one core's cache while it is drawn; wide, short
+// tiles keep each row a long contiguous run, which fills several times faster than square ones at 4K.
+const int RASTER_TILE_WIDTH = 1024;
+const int RASTER_TILE_HEIGHT = 16;
+
+enum class RasterOp : Uint8 { FILL, LINE, SPRITE };
+
+// One recorded draw call
+struct RasterCommand {
+    RasterOp op;
+    Uint8 page;                 // SPRITE: atlas page
+    SDL_Color color;
+    SDL_Rect rect;              // frame pixels: FILL/SPRITE destination, LINE bounds
+    SDL_Rect source;            // SPRITE: atlas area; LINE: endpoints x1, y1, x2, y2 in game pixels
+};
+
+// Offline frame: draw calls recorded in game coordinates, binned per tile, then drawn by the raster threads
+struct RasterFrame {
+    int width, height;
+    float scaleX, scaleY;       // frame pixels per game pixel
+    SDL_Color color;            // current draw colour, like SDL_SetRenderDrawColor()
+    std::vector<Uint32> pixels; // ARGB8888, width * height
+    std::vector<RasterCommand> commands;
+    int tilesX, tilesY;
+    std::vector<std::vector<int>> bins;     // command indices per tile, in recording order
+};
+
+// Function to size a frame; the 800x600 scene is stretched to fill it
+void initRasterFrame(RasterFrame& frame, int width, int height);
+
+// Functions mirroring the SDL renderer calls the scene is drawn with, in game coordinates.
+// Like the renderer's default blend mode, draw-colour alpha is stored, not blended.
+void rasterSetColor(RasterFrame& frame, Uint8 r, Uint8 g, Uint8 b, Uint8 a);
+void rasterClear(RasterFrame& frame);
+void rasterFillRect(RasterFrame& frame, const SDL_Rect& rect);
+void rasterDrawRect(RasterFrame& frame, const SDL_Rect& rect);
+void rasterDrawLine(RasterFrame& frame, int x1, int y1, int x2, int y2);
+void rasterDrawPoint(RasterFrame& frame, int x, int y);
+
+// Function to record an atlas quad, tinted and alpha-blended the way the sprite batch draws it
+void rasterSprite(RasterFrame& frame, const AtlasSprite& sprite, const SDL_Rect& dst, SDL_Color color);
+
+// Function to draw everything recorded into the pixels, tiles spread over the raster threads, and clear the list
+void rasterizeFrame(RasterFrame& frame);
+
+// Function to write the pixels out as a BMP
+bool saveRasterFrame(const RasterFrame& frame, const char* path);
+
+// Function to count pixels that differ from what the renderer currently holds (same size as the frame)
+// by more than one step in any channel
+int compareRasterFrame(const RasterFrame& frame, SDL_Renderer* renderer);
+
+// Functions to start and stop the worker threads (0 = one per core, counting the caller);
+// without them rasterizeFrame() draws every tile on the calling thread
+void startRasterThreads(int threads);
+void stopRasterThreads();
+int rasterThreadCount();
@@ -0,0 +1,492 @@
+#include "replay.h"
+#include "input.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const Uint32 REPLAY_MAGIC = 0x52474E50; // "PNGR"
+static const Uint32 FOOTER_MAGIC = 0x49474E50; // "PNGI"
+static const Uint16 REPLAY_VERSION = 2;        // 1 had no keyframes or index, still playable
+static const Uint8 CHUNK_INPUTS = 'I';
+static const Uint8 CHUNK_KEYFRAME = 'K';
+static const Uint8 CHUNK_INDEX = 'X';
+static const size_t SIM_STATE_SIZE = 64;
+static const size_t REPLAY_HEADER_SIZE = 8 + SIM_STATE_SIZE;
+static const size_t KEYFRAME_RECORD_SIZE = 1 + 4 + SIM_STATE_SIZE + 4;
+static const size_t FOOTER_SIZE = 12;           // index offset, total ticks, magic
+
+// Function to compute the CRC-32 (IEEE) of a byte range
+static Uint32 crc32(const Uint8* data, size_t size) {
+    static Uint32 table[256];
+    static bool tableReady = false;
+    if (!tableReady) {
+        for (Uint32 i = 0; i < 256; ++i) {
+            Uint32 c = i;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            table[i] = c;
+        }
+        tableReady = true;
+    }
+    Uint32 crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; ++i) {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+// Functions to append little-endian values to a byte buffer
+static void putUint16(std::vector<Uint8>& out, Uint16 value) {
+    out.push_back(static_cast<Uint8>(value));
+    out.push_back(static_cast<Uint8>(value >> 8));
+}
+
+static void putUint32(std::vector<Uint8>& out, Uint32 value) {
+    for (int i = 0; i < 4; ++i) {
+        out.push_back(static_cast<Uint8>(value >> (8 * i)));
+    }
+}
+
+static void putFloat(std::vector<Uint8>& out, float value) {
+    Uint32 bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    putUint32(out, bits);
+}
+
+// Functions to read little-endian values back
+static Uint16 getUint16(const Uint8* in) {
+    return static_cast<Uint16>(in[0] | (in[1] << 8));
+}
+
+static Uint32 getUint32(const Uint8* in) {
+    return in[0] | (in[1] << 8) | (in[2] << 16) | (static_cast<Uint32>(in[3]) << 24);
+}
+
+static float getFloat(const Uint8* in) {
+    Uint32 bits = getUint32(in);
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+ReplayInput packReplayInput(bool leftUp, bool leftDown, bool rightUp, bool rightDown) {
+    return static_cast<ReplayInput>((leftUp ? 1 : 0) | (leftDown ? 2 : 0) | (rightUp ? 4 : 0) | (rightDown ? 8 : 0));
+}
+
+void unpackReplayInput(ReplayInput input, bool& leftUp, bool& leftDown, bool& rightUp, bool& rightDown) {
+    leftUp = (input & 1) != 0;
+    leftDown = (input & 2) != 0;
+    rightUp = (input & 4) != 0;
+    rightDown = (input & 8) != 0;
+}
+
+// Function to serialize a game state (explicit fields, so the format doesn't depend on struct layout)
+static void putSimState(std::vector<Uint8>& out, const SimState& state) {
+    putFloat(out, state.ball.x);
+    putFloat(out, state.ball.y);
+    putUint32(out, static_cast<Uint32>(state.ball.r));
+    putFloat(out, state.ball.dx);
+    putFloat(out, state.ball.dy);
+    putFloat(out, state.ball.angle);
+    const Paddle* paddles[2] = { &state.leftPaddle, &state.rightPaddle };
+    for (const Paddle* paddle : paddles) {
+        putUint32(out, static_cast<Uint32>(paddle->x));
+        putUint32(out, static_cast<Uint32>(paddle->y));
+        putUint32(out, static_cast<Uint32>(paddle->w));
+        putUint32(out, static_cast<Uint32>(paddle->h));
+    }
+    putUint32(out, static_cast<Uint32>(state.leftScore));
+    putUint32(out, static_cast<Uint32>(state.rightScore));
+}
+
+static void getSimState(const Uint8* in, SimState& state) {
+    // Fields a replay doesn't store (menu selection, next server) keep their current values
+    saveSimState(state);
+    state.ball.x = getFloat(in);
+    state.ball.y = getFloat(in + 4);
+    state.ball.r = static_cast<int>(getUint32(in + 8));
+    state.ball.dx = getFloat(in + 12);
+    state.ball.dy = getFloat(in + 16);
+    state.ball.angle = getFloat(in + 20);
+    Paddle* paddles[2] = { &state.leftPaddle, &state.rightPaddle };
+    const Uint8* p = in + 24;
+    for (Paddle* paddle : paddles) {
+        paddle->x = static_cast<int>(getUint32(p));
+        paddle->y = static_cast<int>(getUint32(p + 4));
+        paddle->w = static_cast<int>(getUint32(p + 8));
+        paddle->h = static_cast<int>(getUint32(p + 12));
+        p += 16;
+    }
+    state.leftScore = static_cast<int>(getUint32(p));
+    state.rightScore = static_cast<int>(getUint32(p + 4));
+}
+
+// Function to append a run as one LEB128 varint: (length - 1) << 4 | input
+static void putRun(std::vector<Uint8>& out, ReplayInput input, Uint32 length) {
+    Uint32 value = ((length - 1) << 4) | input;
+    while (value >= 0x80) {
+        out.push_back(static_cast<Uint8>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<Uint8>(value));
+}
+
+// Function to append a finished record to the file and push it to disk
+static void writeRecord(ReplayWriter& writer, const std::vector<Uint8>& record) {
+    fwrite(record.data(), 1, record.size(), writer.file);
+    fflush(writer.file);
+    writer.bytesWritten += static_cast<Uint32>(record.size());
+}
+
+// Function to write the pending chunk (tag, size, tick count, runs, CRC) and flush it to disk
+static void writeChunk(ReplayWriter& writer) {
+    if (writer.runLength > 0) {
+        putRun(writer.chunk, writer.runInput, writer.runLength);
+        writer.runLength = 0;
+    }
+    if (writer.chunkTicks == 0) {
+        return;
+    }
+    // Built in the writer's reusable buffer, so recording doesn't allocate once it has warmed up
+    std::vector<Uint8>& record = writer.record;
+    record.clear();
+    record.push_back(CHUNK_INPUTS);
+    putUint16(record, static_cast<Uint16>(2 + writer.chunk.size()));
+    putUint16(record, static_cast<Uint16>(writer.chunkTicks));
+    record.insert(record.end(), writer.chunk.begin(), writer.chunk.end());
+    putUint32(record, crc32(record.data() + 3, record.size() - 3));
+
+    writeRecord(writer, record);
+    writer.chunk.clear();
+    writer.chunkTicks = 0;
+}
+
+// Function to write a keyframe (tag, tick, state, CRC) with the current game state and index it
+static void writeKeyframe(ReplayWriter& writer) {
+    SimState state;
+    saveSimState(state);
+    std::vector<Uint8>& record = writer.record;
+    record.clear();
+    record.push_back(CHUNK_KEYFRAME);
+    putUint32(record, writer.ticks);
+    putSimState(record, state);
+    putUint32(record, crc32(record.data() + 1, record.size() - 1));
+
+    ReplayKeyframe keyframe = { writer.ticks, writer.bytesWritten };
+    writer.index.push_back(keyframe);
+    writeRecord(writer, record);
+}
+
+bool startReplayRecording(ReplayWriter& writer, const char* path) {
+    writer.file = fopen(path, "wb");
+    if (writer.file == nullptr) {
+        std::cerr << "Could not create replay file " << path << "!" << std::endl;
+        return false;
+    }
+    writer.ticks = 0;
+    writer.bytesWritten = 0;
+    writer.runInput = 0;
+    writer.runLength = 0;
+    writer.chunkTicks = 0;
+    writer.chunk.clear();
+    writer.index.clear();
+
+    SimState state;
+    saveSimState(state);
+    std::vector<Uint8> header;
+    putUint32(header, REPLAY_MAGIC);
+    putUint16(header, REPLAY_VERSION);
+    putUint16(header, static_cast<Uint16>(TICK_MS));
+    putSimState(header, state);
+    writeRecord(writer, header);
+    return true;
+}
+
+void recordReplayTick(ReplayWriter& writer, ReplayInput input) {
+    if (writer.file == nullptr) {
+        return;
+    }
+    // Keyframes sit on chunk boundaries, so seeking never starts in the middle of a chunk
+    if (writer.ticks % REPLAY_KEYFRAME_TICKS == 0) {
+        writeChunk(writer);
+        writeKeyframe(writer);
+    }
+    if (writer.runLength > 0 && input != writer.runInput) {
+        putRun(writer.chunk, writer.runInput, writer.runLength);
+        writer.runLength = 0;
+    }
+    writer.runInput = input;
+    ++writer.runLength;
+    ++writer.chunkTicks;
+    ++writer.ticks;
+    if (writer.chunkTicks == REPLAY_CHUNK_TICKS) {
+        writeChunk(writer);
+    }
+}
+
+void finishReplayRecording(ReplayWriter& writer) {
+    if (writer.file == nullptr) {
+        return;
+    }
+    writeChunk(writer);
+
+    // Index record, then a fixed-size footer pointing at it
+    Uint32 indexOffset = writer.bytesWritten;
+    std::vector<Uint8> record;
+    record.push_back(CHUNK_INDEX);
+    putUint32(record, static_cast<Uint32>(writer.index.size()));
+    for (const ReplayKeyframe& keyframe : writer.index) {
+        putUint32(record, keyframe.tick);
+        putUint32(record, keyframe.offset);
+    }
+    putUint32(record, crc32(record.data() + 1, record.size() - 1));
+    putUint32(record, indexOffset);
+    putUint32(record, writer.ticks);
+    putUint32(record, FOOTER_MAGIC);
+    writeRecord(writer, record);
+
+    fclose(writer.file);
+    writer.file = nullptr;
+    std::cout << "Replay: " << writer.ticks << " ticks, " << writer.index.size() << " keyframes in " << writer.bytesWritten << " bytes ("
+        << (writer.ticks > 0 ? writer.bytesWritten * 1000.0 / (writer.ticks * TICK_MS) : 0.0) << " bytes/s)" << std::endl;
+}
+
+// Function to map a whole file read-only, returns nullptr on failure
+static const Uint8* mapFile(const char* path, size_t& size) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return nullptr;
+    }
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+        CloseHandle(file);
+        return nullptr;
+    }
+    // The view keeps the mapping alive, both handles can go
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (mapping == NULL) {
+        return nullptr;
+    }
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    size = static_cast<size_t>(fileSize.QuadPart);
+    return static_cast<const Uint8*>(view);
+#else
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+        return nullptr;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        ::close(fd);
+        return nullptr;
+    }
+    void* view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (view == MAP_FAILED) {
+        return nullptr;
+    }
+    size = static_cast<size_t>(info.st_size);
+    return static_cast<const Uint8*>(view);
+#endif
+}
+
+void closeReplay(ReplayReader& reader) {
+    if (reader.data == nullptr) {
+        return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(reader.data);
+#else
+    munmap(const_cast<Uint8*>(reader.data), reader.size);
+#endif
+    reader.data = nullptr;
+    reader.size = 0;
+}
+
+// Function to get the size of an intact record at an offset, 0 if it is damaged, cut off or unknown
+static size_t recordSize(const ReplayReader& reader, size_t offset) {
+    const Uint8* data = reader.data;
+    if (offset + 1 > reader.size) {
+        return 0;
+    }
+    size_t size = 0;
+    size_t checked = 0; // bytes covered by the CRC, starting after the tag
+    switch (data[offset]) {
+    case CHUNK_INPUTS:
+        if (offset + 3 > reader.size) {
+            return 0;
+        }
+        checked = getUint16(&data[offset + 1]);
+        if (checked < 2 || offset + 3 + checked + 4 > reader.size ||
+            crc32(&data[offset + 3], checked) != getUint32(&data[offset + 3 + checked])) {
+            return 0;
+        }
+        return 3 + checked + 4;
+    case CHUNK_KEYFRAME:
+        size = KEYFRAME_RECORD_SIZE;
+        break;
+    case CHUNK_INDEX:
+        if (offset + 5 > reader.size) {
+            return 0;
+        }
+        size = 1 + 4 + static_cast<size_t>(getUint32(&data[offset + 1])) * 8 + 4;
+        break;
+    default:
+        return 0;
+    }
+    checked = size - 5;
+    if (offset + size > reader.size || crc32(&data[offset + 1], checked) != getUint32(&data[offset + 1 + checked])) {
+        return 0;
+    }
+    return size;
+}
+
+// Function to rebuild the index of a recording that never wrote its footer
+static void scanReplay(ReplayReader& reader) {
+    size_t offset = REPLAY_HEADER_SIZE;
+    size_t size;
+    while ((size = recordSize(reader, offset)) > 0) {
+        if (reader.data[offset] == CHUNK_INPUTS) {
+            reader.totalTicks += getUint16(&reader.data[offset + 3]);
+        }
+        else if (reader.data[offset] == CHUNK_KEYFRAME) {
+            ReplayKeyframe keyframe = { getUint32(&reader.data[offset + 1]), static_cast<Uint32>(offset) };
+            reader.index.push_back(keyframe);
+        }
+        else {
+            break;
+        }
+        offset += size;
+    }
+}
+
+// Function to load the index the footer points at, false if there is no intact footer
+static bool readFooter(ReplayReader& reader) {
+    if (reader.size < REPLAY_HEADER_SIZE + FOOTER_SIZE || getUint32(reader.data + reader.size - 4) != FOOTER_MAGIC) {
+        return false;
+    }
+    size_t indexOffset = getUint32(reader.data + reader.size - FOOTER_SIZE);
+    if (indexOffset < REPLAY_HEADER_SIZE || indexOffset >= reader.size || reader.data[indexOffset] != CHUNK_INDEX ||
+        recordSize(reader, indexOffset) == 0) {
+        return false;
+    }
+    Uint32 count = getUint32(reader.data + indexOffset + 1);
+    const Uint8* entry = reader.data + indexOffset + 5;
+    for (Uint32 i = 0; i < count; ++i, entry += 8) {
+        ReplayKeyframe keyframe = { getUint32(entry), getUint32(entry + 4) };
+        reader.index.push_back(keyframe);
+    }
+    reader.totalTicks = getUint32(reader.data + reader.size - FOOTER_SIZE + 4);
+    return true;
+}
+
+bool openReplay(ReplayReader& reader, const char* path) {
+    reader.data = mapFile(path, reader.size);
+    if (reader.data == nullptr) {
+        std::cerr << "Could not open replay file " << path << "!" << std::endl;
+        return false;
+    }
+
+    Uint16 version = reader.size >= REPLAY_HEADER_SIZE ? getUint16(reader.data + 4) : 0;
+    if (reader.size < REPLAY_HEADER_SIZE || getUint32(reader.data) != REPLAY_MAGIC ||
+        version < 1 || version > REPLAY_VERSION) {
+        std::cerr << path << " is not a replay this version can play!" << std::endl;
+        closeReplay(reader);
+        return false;
+    }
+    reader.tickMs = getUint16(reader.data + 6);
+    getSimState(reader.data + 8, reader.initialState);
+
+    reader.index.clear();
+    reader.totalTicks = 0;
+    if (!readFooter(reader)) {
+        reader.index.clear();
+        scanReplay(reader);
+    }
+
+    reader.chunkOffset = REPLAY_HEADER_SIZE;
+    reader.runOffset = 0;
+    reader.chunkEnd = 0;
+    reader.runRemaining = 0;
+    reader.tick = 0;
+    return true;
+}
+
+// Function to step into the next intact input chunk, skipping keyframes; false at the index or a damaged tail
+static bool enterNextChunk(ReplayReader& reader) {
+    size_t size;
+    while ((size = recordSize(reader, reader.chunkOffset)) > 0) {
+        size_t offset = reader.chunkOffset;
+        reader.chunkOffset += size;
+        if (reader.data[offset] == CHUNK_INPUTS) {
+            reader.runOffset = offset + 5;
+            reader.chunkEnd = offset + size - 4;
+            return true;
+        }
+        if (reader.data[offset] != CHUNK_KEYFRAME) {
+            break;
+        }
+    }
+    return false;
+}
+
+bool nextReplayInput(ReplayReader& reader, ReplayInput& input) {
+    while (reader.runRemaining == 0) {
+        if (reader.runOffset >= reader.chunkEnd && !enterNextChunk(reader)) {
+            return false;
+        }
+        // Decode one varint run
+        Uint32 value = 0;
+        int shift = 0;
+        while (reader.runOffset < reader.chunkEnd) {
+            Uint8 byte = reader.data[reader.runOffset++];
+            value |= static_cast<Uint32>(byte & 0x7F) << shift;
+            shift += 7;
+            if ((byte & 0x80) == 0) {
+                break;
+            }
+        }
+        reader.runInput = static_cast<ReplayInput>(value & 0xF);
+        reader.runRemaining = (value >> 4) + 1;
+    }
+    input = reader.runInput;
+    --reader.runRemaining;
+    ++reader.tick;
+    return true;
+}
+
+Uint32 seekReplay(ReplayReader& reader, Uint32 tick) {
+    reader.runOffset = 0;
+    reader.chunkEnd = 0;
+    reader.runRemaining = 0;
+
+    // Last keyframe at or before the tick; before the first one (or in a version 1 file) start over from the header
+    std::vector<ReplayKeyframe>::const_iterator next = std::upper_bound(reader.index.begin(), reader.index.end(), tick,
+        [](Uint32 value, const ReplayKeyframe& keyframe) { return value < keyframe.tick; });
+    if (next == reader.index.begin()) {
+        loadSimState(reader.initialState);
+        reader.chunkOffset = REPLAY_HEADER_SIZE;
+        reader.tick = 0;
+        return 0;
+    }
+    const ReplayKeyframe& keyframe = *(next - 1);
+    SimState state;
+    getSimState(reader.data + keyframe.offset + 5, state);
+    loadSimState(state);
+    reader.chunkOffset = keyframe.offset + KEYFRAME_RECORD_SIZE;
+    reader.tick = keyframe.tick;
+    return keyframe.tick;
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include "netplay.h"
+#include <cstdio>
+#include <vector>
+
+// Ticks of input per chunk; a chunk is flushed to disk as soon as it is complete,
+// so a crash loses at most this many ticks
+const int REPLAY_CHUNK_TICKS = 500;
+// Ticks between state keyframes (a multiple of the chunk size); a seek re-simulates at most this many
+const int REPLAY_KEYFRAME_TICKS = 1000;
+
+// Per-tick controls packed into 4 bits: left up, left down, right up, right down
+typedef Uint8 ReplayInput;
+
+// Function to pack/unpack the controls handleGameInput() applied on a tick
+ReplayInput packReplayInput(bool leftUp, bool leftDown, bool rightUp, bool rightDown);
+void unpackReplayInput(ReplayInput input, bool& leftUp, bool& leftDown, bool& rightUp, bool& rightDown);
+
+// Index entry: the game state at the start of a tick is stored at this file offset
+struct ReplayKeyframe {
+    Uint32 tick;
+    Uint32 offset;
+};
+
+// Append-only replay writer
+struct ReplayWriter {
+    FILE* file;
+    Uint32 ticks;               // ticks written so far
+    Uint32 bytesWritten;
+    ReplayInput runInput;       // input of the run being extended
+    Uint32 runLength;
+    Uint32 chunkTicks;          // ticks covered by the pending chunk
+    std::vector<Uint8> chunk;   // encoded runs not yet on disk
+    std::vector<Uint8> record;  // scratch for the record being written
+    std::vector<ReplayKeyframe> index;
+};
+
+// Function to create the file and write the header with the current game state as the starting point
+bool startReplayRecording(ReplayWriter& writer, const char* path);
+
+// Function to append one tick's controls; call it before the tick changes the game state,
+// so keyframes hold the state the tick starts from
+void recordReplayTick(ReplayWriter& writer, ReplayInput input);
+
+// Function to flush the last chunk, write the keyframe index footer and close the file
+void finishReplayRecording(ReplayWriter& writer);
+
+// Replay reader: file memory-mapped, inputs decoded one tick at a time
+struct ReplayReader {
+    const Uint8* data;
+    size_t size;
+    SimState initialState;
+    Uint32 tickMs;
+    Uint32 totalTicks;
+    std::vector<ReplayKeyframe> index;  // sorted by tick
+    size_t chunkOffset;         // next record
+    size_t runOffset;           // next run inside the current chunk
+    size_t chunkEnd;
+    ReplayInput runInput;
+    Uint32 runRemaining;
+    Uint32 tick;                // next tick nextReplayInput() returns
+};
+
+// Function to map a replay and load its keyframe index. A crashed recording has no footer,
+// so the index is rebuilt by walking the chunks up to the first damaged one.
+bool openReplay(ReplayReader& reader, const char* path);
+
+// Function to unmap the file
+void closeReplay(ReplayReader& reader);
+
+// Function to get the next tick's controls, returns false at the end of the replay
+bool nextReplayInput(ReplayReader& reader, ReplayInput& input);
+
+// Function to load the nearest keyframe at or before a tick into the game globals and continue
+// reading from there. Returns the keyframe's tick; the caller simulates the rest of the way.
+Uint32 seekReplay(ReplayReader& reader, Uint32 tick);
@@ -0,0 +1,143 @@
+#include "resolution.h"
+#include "game.h"
+#include "perfhud.h"
+#include <cmath>
+#include <iostream>
+
+static SDL_Texture* target = nullptr;
+static float budget = 0.0f;
+static float scale = RESOLUTION_MAX_SCALE;
+static float lowestScale = RESOLUTION_MAX_SCALE;
+static int scaleChanges = 0;
+
+// Frame-time histogram over the last RESOLUTION_WINDOW_FRAMES frames
+static int histogram[RESOLUTION_BUCKETS];
+static int windowBuckets[RESOLUTION_WINDOW_FRAMES];
+static int windowCount = 0;
+static int windowIndex = 0;
+
+// Function to get the internal size for a scale, in whole pixels
+static void scaledSize(float value, int& width, int& height) {
+    width = static_cast<int>(SCREEN_WIDTH * value + 0.5f);
+    height = static_cast<int>(SCREEN_HEIGHT * value + 0.5f);
+}
+
+bool initDynamicResolution(SDL_Renderer* renderer, float budgetMs) {
+    // Smooth the upscale; the hint is read when the texture is created
+    const char* oldQuality = SDL_GetHint(SDL_HINT_RENDER_SCALE_QUALITY);
+    SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "linear");
+    target = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_TARGET, SCREEN_WIDTH, SCREEN_HEIGHT);
+    SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, oldQuality != nullptr ? oldQuality : "nearest");
+    if (target == nullptr) {
+        std::cerr << "Render target could not be created! SDL_Error: " << SDL_GetError() << std::endl;
+        return false;
+    }
+    hudCount(HudCounter::TEXTURES);
+    budget = budgetMs;
+    scale = RESOLUTION_MAX_SCALE;
+    lowestScale = scale;
+    scaleChanges = 0;
+    windowCount = 0;
+    windowIndex = 0;
+    SDL_memset(histogram, 0, sizeof(histogram));
+    return true;
+}
+
+void destroyDynamicResolution() {
+    if (target == nullptr) {
+        return;
+    }
+    std::cout << "Dynamic resolution: " << budget << " ms budget, " << scaleChanges << " scale changes, final scale "
+        << scale << ", lowest " << lowestScale << std::endl;
+    SDL_DestroyTexture(target);
+    target = nullptr;
+}
+
+bool dynamicResolutionActive() {
+    return target != nullptr;
+}
+
+void beginScaledFrame(SDL_Renderer* renderer) {
+    if (target == nullptr) {
+        return;
+    }
+    SDL_SetRenderTarget(renderer, target);
+    SDL_RenderSetScale(renderer, scale, scale);
+}
+
+void endScaledFrame(SDL_Renderer* renderer) {
+    if (target == nullptr) {
+        return;
+    }
+    int width, height;
+    scaledSize(scale, width, height);
+    SDL_Rect source = { 0, 0, width, height };
+    SDL_SetRenderTarget(renderer, NULL);
+    SDL_RenderSetScale(renderer, 1.0f, 1.0f);
+    SDL_RenderCopy(renderer, target, &source, NULL);
+}
+
+// Function to get the frame time the slowest tenth of the window is at or above
+static float percentile90() {
+    int remaining = windowCount / 10;
+    for (int bucket = RESOLUTION_BUCKETS - 1; bucket >= 0; --bucket) {
+        remaining -= histogram[bucket];
+        if (remaining < 0) {
+            return (bucket + 1) * RESOLUTION_BUCKET_MS;
+        }
+    }
+    return 0.0f;
+}
+
+// Function to switch scale and start a fresh window, since old frame times no longer apply
+static void setScale(float value) {
+    value = value < RESOLUTION_MIN_SCALE ? RESOLUTION_MIN_SCALE : (value > RESOLUTION_MAX_SCALE ? RESOLUTION_MAX_SCALE : value);
+    if (std::fabs(value - scale) < 0.005f) {
+        return;
+    }
+    scale = value;
+    lowestScale = scale < lowestScale ? scale : lowestScale;
+    ++scaleChanges;
+    windowCount = 0;
+    windowIndex = 0;
+    SDL_memset(histogram, 0, sizeof(histogram));
+}
+
+void recordFrameTime(float milliseconds) {
+    if (target == nullptr) {
+        return;
+    }
+    int bucket = static_cast<int>(milliseconds / RESOLUTION_BUCKET_MS);
+    bucket = bucket < 0 ? 0 : (bucket >= RESOLUTION_BUCKETS ? RESOLUTION_BUCKETS - 1 : bucket);
+    if (windowCount == RESOLUTION_WINDOW_FRAMES) {
+        --histogram[windowBuckets[windowIndex]];
+    }
+    else {
+        ++windowCount;
+    }
+    windowBuckets[windowIndex] = bucket;
+    ++histogram[bucket];
+    windowIndex = (windowIndex + 1) % RESOLUTION_WINDOW_FRAMES;
+
+    if (windowCount < RESOLUTION_WINDOW_FRAMES) {
+        return;
+    }
+    // Fill cost goes with the pixel count, the square of the scale. Drop straight to the scale
+    // that should fit (at most a quarter at a time); climb back one small step at a time, and only
+    // when that step is predicted to stay under 90% of the budget, so it doesn't oscillate.
+    float slow = percentile90();
+    if (slow > budget) {
+        float fit = std::sqrt(budget / slow);
+        setScale(scale * (fit < 0.75f ? 0.75f : (fit > 0.95f ? 0.95f : fit)));
+    }
+    else if (scale < RESOLUTION_MAX_SCALE) {
+        float next = scale + RESOLUTION_STEP;
+        if (slow * (next * next) / (scale * scale) < budget * 0.9f) {
+            setScale(next);
+        }
+    }
+}
+
+float renderScale() {
+    return scale;
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <SDL.h>
+
+// Range and step of the internal render scale (1 = native SCREEN_WIDTH x SCREEN_HEIGHT)
+const float RESOLUTION_MIN_SCALE = 0.4f;
+const float RESOLUTION_MAX_SCALE = 1.0f;
+const float RESOLUTION_STEP = 0.05f;
+// Frames of history the controller looks at before it changes the scale again
+const int RESOLUTION_WINDOW_FRAMES = 60;
+// Frame-time histogram: bucket width and count (the last bucket holds everything slower)
+const float RESOLUTION_BUCKET_MS = 0.25f;
+const int RESOLUTION_BUCKETS = 128;
+
+// Function to create the internal render target and start holding frames under budgetMs
+bool initDynamicResolution(SDL_Renderer* renderer, float budgetMs);
+void destroyDynamicResolution();
+bool dynamicResolutionActive();
+
+// Functions to wrap a frame's drawing: draw in game coordinates into the scaled-down target,
+// then stretch it over the window
+void beginScaledFrame(SDL_Renderer* renderer);
+void endScaledFrame(SDL_Renderer* renderer);
+
+// Function to feed the controller how long the last frame took to draw and present
+void recordFrameTime(float milliseconds);
+
+// Function to get the current internal render scale
+float renderScale();
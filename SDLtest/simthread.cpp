@@ -0,0 +1,146 @@
+#include "simthread.h"
+#include "input.h"
+#include "trace.h"
+#include <iostream>
+#include <thread>
+
+// Flag on TripleBuffer::middle: the slot holds a snapshot the consumer hasn't taken yet
+static const int TRIPLE_BUFFER_FRESH = 4;
+
+static TripleBuffer simBuffer;
+static std::thread simThread;
+static std::atomic<bool> simStopping(false);
+static std::atomic<bool> simPaused(false);
+static bool simActive = false;
+static SimTickFunction simTick = nullptr;
+
+// Counters for the report, each written by one thread and read after the join
+static Uint32 ticksRun = 0;
+static Uint32 resyncs = 0;              // times the clock was reset after falling behind
+static Sint32 worstLateMs = 0;          // longest a tick started after its window closed
+static Uint32 snapshotsPublished = 0;
+static Uint32 snapshotsDrawn = 0;
+
+void initTripleBuffer(TripleBuffer& buffer, const SimSnapshot& initial) {
+    for (SimSnapshot& slot : buffer.slots) {
+        slot = initial;
+    }
+    buffer.back = 0;
+    buffer.middle = 1;
+    buffer.front = 2;
+}
+
+SimSnapshot& tripleBufferBack(TripleBuffer& buffer) {
+    return buffer.slots[buffer.back];
+}
+
+void publishTripleBuffer(TripleBuffer& buffer) {
+    // Release so the consumer sees the whole snapshot once it sees the index
+    int old = buffer.middle.exchange(buffer.back | TRIPLE_BUFFER_FRESH, std::memory_order_acq_rel);
+    buffer.back = old & ~TRIPLE_BUFFER_FRESH;
+}
+
+const SimSnapshot& tripleBufferFront(TripleBuffer& buffer, bool& fresh) {
+    fresh = (buffer.middle.load(std::memory_order_relaxed) & TRIPLE_BUFFER_FRESH) != 0;
+    if (fresh) {
+        int old = buffer.middle.exchange(buffer.front, std::memory_order_acq_rel);
+        buffer.front = old & ~TRIPLE_BUFFER_FRESH;
+    }
+    return buffer.slots[buffer.front];
+}
+
+// Function run by the simulation thread: the fixed-rate tick loop of main(), publishing instead of rendering
+static void simulationLoop() {
+    traceThreadName("simulation");
+    Uint32 tickEnd = SDL_GetTicks() + TICK_MS;
+    while (!simStopping.load(std::memory_order_acquire)) {
+        // Paused time isn't owed: carry on from the resume instead of catching up
+        if (simPaused.load(std::memory_order_acquire)) {
+            SDL_Delay(SIM_PAUSE_POLL_MS);
+            tickEnd = SDL_GetTicks() + TICK_MS;
+            continue;
+        }
+        int ticks = 0;
+        while (static_cast<Sint32>(SDL_GetTicks() - tickEnd) >= 0 && ticks < SIM_MAX_CATCHUP_TICKS) {
+            Sint32 late = static_cast<Sint32>(SDL_GetTicks() - tickEnd);
+            if (late > worstLateMs) {
+                worstLateMs = late;
+            }
+            {
+                TRACE_SCOPE("tick");
+                simTick(tickEnd);
+            }
+            tickEnd += TICK_MS;
+            ++ticks;
+            ++ticksRun;
+        }
+
+        // After the serve pause or a long stall, carry on from now instead of fast-forwarding
+        if (static_cast<Sint32>(SDL_GetTicks() - tickEnd) >= static_cast<Sint32>(TICK_MS)) {
+            tickEnd = SDL_GetTicks() + TICK_MS;
+            ++resyncs;
+        }
+
+        if (ticks > 0) {
+            SimSnapshot& snapshot = tripleBufferBack(simBuffer);
+            saveGameState(snapshot.state);
+            snapshot.tick = ticksRun;
+            snapshot.nextTickMs = tickEnd;
+            publishTripleBuffer(simBuffer);
+            ++snapshotsPublished;
+        }
+
+        Sint32 untilNextTick = static_cast<Sint32>(tickEnd - SDL_GetTicks());
+        if (untilNextTick > 0) {
+            SDL_Delay(untilNextTick);
+        }
+    }
+}
+
+void startSimulationThread(SimTickFunction tick) {
+    SimSnapshot initial;
+    saveGameState(initial.state);
+    initial.tick = 0;
+    initial.nextTickMs = SDL_GetTicks() + TICK_MS;
+    initTripleBuffer(simBuffer, initial);
+
+    simTick = tick;
+    ticksRun = 0;
+    resyncs = 0;
+    worstLateMs = 0;
+    snapshotsPublished = 0;
+    snapshotsDrawn = 0;
+    simStopping = false;
+    simPaused = false;
+    simThread = std::thread(simulationLoop);
+    simActive = true;
+}
+
+void stopSimulationThread() {
+    if (!simActive) {
+        return;
+    }
+    simStopping = true;
+    simThread.join();
+    simActive = false;
+
+    std::cout << "Simulation thread: " << ticksRun << " ticks, " << resyncs << " clock resyncs, worst tick "
+              << worstLateMs << " ms late; renderer drew " << snapshotsDrawn << " of " << snapshotsPublished
+              << " snapshots" << std::endl;
+}
+
+void pauseSimulationThread(bool paused) {
+    simPaused.store(paused, std::memory_order_release);
+}
+
+bool simulationThreadActive() {
+    return simActive;
+}
+
+const SimSnapshot& latestSimSnapshot(bool& fresh) {
+    return tripleBufferFront(simBuffer, fresh);
+}
+
+void noteSimSnapshotDrawn() {
+    ++snapshotsDrawn;
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include "game.h"
+#include <atomic>
+
+// Most ticks the simulation thread runs back-to-back before resyncing its clock
+const int SIM_MAX_CATCHUP_TICKS = 5;
+// How often a paused simulation thread checks whether to carry on
+const Uint32 SIM_PAUSE_POLL_MS = 50;
+
+// What the simulation hands the renderer after each batch of ticks
+struct SimSnapshot {
+    GameState state;
+    Uint32 tick;            // ticks simulated so far
+    Uint32 nextTickMs;      // SDL_GetTicks() time the next tick is due, when a newer snapshot can appear
+};
+
+// Lock-free triple buffer: the producer fills the back slot and swaps it with the middle one, the
+// consumer swaps the middle slot for its front one whenever a fresh state is waiting. Neither side
+// ever waits, and the consumer always gets the newest complete snapshot.
+struct TripleBuffer {
+    SimSnapshot slots[3];
+    std::atomic<int> middle;    // slot index, plus TRIPLE_BUFFER_FRESH once published and not yet taken
+    int back;                   // producer's slot
+    int front;                  // consumer's slot
+};
+
+// Function to put the same snapshot in every slot, before either side starts
+void initTripleBuffer(TripleBuffer& buffer, const SimSnapshot& initial);
+
+// Function to get the slot the producer writes the next snapshot into
+SimSnapshot& tripleBufferBack(TripleBuffer& buffer);
+
+// Function to make the back slot the newest snapshot
+void publishTripleBuffer(TripleBuffer& buffer);
+
+// Function to get the newest published snapshot; stays valid until the next call. Sets fresh
+// to whether it changed since the last call.
+const SimSnapshot& tripleBufferFront(TripleBuffer& buffer, bool& fresh);
+
+// A tick of the game: called on the simulation thread with the end of the tick's input window
+typedef void (*SimTickFunction)(Uint32 tickEnd);
+
+// Function to start running tick every TICK_MS on its own thread, publishing the game state after each batch.
+// From here on only the simulation thread may touch the game globals.
+void startSimulationThread(SimTickFunction tick);
+
+// Function to stop the thread, leave its final state in the game globals and print how steady the ticks were
+void stopSimulationThread();
+
+// Function to hold the ticks (the window is hidden) or let them carry on; the clock restarts on resume
+void pauseSimulationThread(bool paused);
+
+// Function to check whether the simulation is running on its own thread
+bool simulationThreadActive();
+
+// Function to get the newest game state for the renderer, fresh says whether it is new since the last call
+const SimSnapshot& latestSimSnapshot(bool& fresh);
+
+// Function to count a fresh snapshot the renderer actually drew, for the report; a throttled window skips some
+void noteSimSnapshotDrawn();
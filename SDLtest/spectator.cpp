@@ -0,0 +1,508 @@
+#include "spectator.h"
+#include "ai.h"
+#include "game.h"
+#include "input.h"
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+// Bits per quantised field, and the scale/bias that map the game value onto it
+static const int FIELD_BITS[SNAPSHOT_FIELD_COUNT] = { 13, 13, 12, 12, 10, 10, 10, 16, 16 };
+static const float FIELD_SCALE[SNAPSHOT_FIELD_COUNT] = { 8.0f, 8.0f, 64.0f, 64.0f, 2.0f, 1.0f, 1.0f, 1.0f, 1.0f };
+static const float FIELD_BIAS[SNAPSHOT_FIELD_COUNT] = { 64.0f, 64.0f, 32.0f, 32.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+
+// Changed fields within this signed distance of the baseline are sent as an 8-bit delta
+const int SMALL_DELTA_BITS = 8;
+// Message: u16 size of the rest, u32 tick, u8 flags, then the bit-packed fields
+const int MESSAGE_HEADER_SIZE = 7;
+const Uint8 MESSAGE_KEYFRAME = 1;   // fields are relative to all zeros rather than the previous snapshot
+
+// Function to map a game value onto a field's fixed-point range
+static Uint16 quantise(int field, float value) {
+    long scaled = std::lround((value + FIELD_BIAS[field]) * FIELD_SCALE[field]);
+    long maxValue = (1L << FIELD_BITS[field]) - 1;
+    return static_cast<Uint16>(scaled < 0 ? 0 : (scaled > maxValue ? maxValue : scaled));
+}
+
+static float dequantise(int field, Uint16 value) {
+    return value / FIELD_SCALE[field] - FIELD_BIAS[field];
+}
+
+void captureSnapshot(SpectatorSnapshot& snapshot, Uint32 tick) {
+    float angle = std::fmod(ball.angle, 360.0f);
+    if (angle < 0.0f) {
+        angle += 360.0f;
+    }
+    snapshot.tick = tick;
+    snapshot.fields[SNAPSHOT_BALL_X] = quantise(SNAPSHOT_BALL_X, ball.x);
+    snapshot.fields[SNAPSHOT_BALL_Y] = quantise(SNAPSHOT_BALL_Y, ball.y);
+    snapshot.fields[SNAPSHOT_BALL_DX] = quantise(SNAPSHOT_BALL_DX, ball.dx);
+    snapshot.fields[SNAPSHOT_BALL_DY] = quantise(SNAPSHOT_BALL_DY, ball.dy);
+    snapshot.fields[SNAPSHOT_BALL_ANGLE] = quantise(SNAPSHOT_BALL_ANGLE, angle);
+    snapshot.fields[SNAPSHOT_LEFT_Y] = quantise(SNAPSHOT_LEFT_Y, static_cast<float>(leftPaddle.y));
+    snapshot.fields[SNAPSHOT_RIGHT_Y] = quantise(SNAPSHOT_RIGHT_Y, static_cast<float>(rightPaddle.y));
+    snapshot.fields[SNAPSHOT_LEFT_SCORE] = quantise(SNAPSHOT_LEFT_SCORE, static_cast<float>(leftScore));
+    snapshot.fields[SNAPSHOT_RIGHT_SCORE] = quantise(SNAPSHOT_RIGHT_SCORE, static_cast<float>(rightScore));
+}
+
+// Little bit writer/reader, least significant bit first
+struct BitWriter {
+    std::vector<Uint8>* out;
+    Uint32 accumulator;
+    int bits;
+};
+
+static void putBits(BitWriter& writer, Uint32 value, int count) {
+    writer.accumulator |= (value & ((1u << count) - 1)) << writer.bits;
+    writer.bits += count;
+    while (writer.bits >= 8) {
+        writer.out->push_back(static_cast<Uint8>(writer.accumulator));
+        writer.accumulator >>= 8;
+        writer.bits -= 8;
+    }
+}
+
+static void flushBits(BitWriter& writer) {
+    if (writer.bits > 0) {
+        writer.out->push_back(static_cast<Uint8>(writer.accumulator));
+    }
+    writer.accumulator = 0;
+    writer.bits = 0;
+}
+
+struct BitReader {
+    const Uint8* data;
+    size_t size;
+    size_t offset;
+    Uint32 accumulator;
+    int bits;
+};
+
+// Function to read bits, false if the message ends first
+static bool getBits(BitReader& reader, int count, Uint32& value) {
+    while (reader.bits < count) {
+        if (reader.offset >= reader.size) {
+            return false;
+        }
+        reader.accumulator |= static_cast<Uint32>(reader.data[reader.offset++]) << reader.bits;
+        reader.bits += 8;
+    }
+    value = reader.accumulator & ((1u << count) - 1);
+    reader.accumulator >>= count;
+    reader.bits -= count;
+    return true;
+}
+
+// Function to encode a snapshot against a baseline (nullptr = keyframe)
+static void encodeSnapshot(std::vector<Uint8>& out, const SpectatorSnapshot& snapshot, const SpectatorSnapshot* baseline) {
+    out.clear();
+    out.resize(MESSAGE_HEADER_SIZE);
+    out[2] = static_cast<Uint8>(snapshot.tick);
+    out[3] = static_cast<Uint8>(snapshot.tick >> 8);
+    out[4] = static_cast<Uint8>(snapshot.tick >> 16);
+    out[5] = static_cast<Uint8>(snapshot.tick >> 24);
+    out[6] = baseline == nullptr ? MESSAGE_KEYFRAME : 0;
+
+    BitWriter writer = { &out, 0, 0 };
+    Uint32 changed = 0;
+    for (int field = 0; field < SNAPSHOT_FIELD_COUNT; ++field) {
+        Uint16 base = baseline == nullptr ? 0 : baseline->fields[field];
+        if (snapshot.fields[field] != base) {
+            changed |= 1u << field;
+        }
+    }
+    putBits(writer, changed, SNAPSHOT_FIELD_COUNT);
+    for (int field = 0; field < SNAPSHOT_FIELD_COUNT; ++field) {
+        if ((changed & (1u << field)) == 0) {
+            continue;
+        }
+        int base = baseline == nullptr ? 0 : baseline->fields[field];
+        int delta = snapshot.fields[field] - base;
+        if (baseline != nullptr && delta >= -(1 << (SMALL_DELTA_BITS - 1)) && delta < (1 << (SMALL_DELTA_BITS - 1))) {
+            putBits(writer, 1, 1);
+            putBits(writer, static_cast<Uint32>(delta), SMALL_DELTA_BITS);
+        }
+        else {
+            putBits(writer, 0, 1);
+            putBits(writer, snapshot.fields[field], FIELD_BITS[field]);
+        }
+    }
+    flushBits(writer);
+
+    Uint16 size = static_cast<Uint16>(out.size() - 2);
+    out[0] = static_cast<Uint8>(size);
+    out[1] = static_cast<Uint8>(size >> 8);
+}
+
+// Function to decode one message body (everything after the size) against a baseline
+static bool decodeSnapshot(const Uint8* data, size_t size, const SpectatorSnapshot* baseline, SpectatorSnapshot& snapshot) {
+    if (size < MESSAGE_HEADER_SIZE - 2) {
+        return false;
+    }
+    snapshot.tick = data[0] | (data[1] << 8) | (data[2] << 16) | (static_cast<Uint32>(data[3]) << 24);
+    bool keyframe = (data[4] & MESSAGE_KEYFRAME) != 0;
+    if (!keyframe && baseline == nullptr) {
+        return false;
+    }
+
+    BitReader reader = { data + 5, size - 5, 0, 0, 0 };
+    Uint32 changed;
+    if (!getBits(reader, SNAPSHOT_FIELD_COUNT, changed)) {
+        return false;
+    }
+    for (int field = 0; field < SNAPSHOT_FIELD_COUNT; ++field) {
+        Uint16 base = keyframe ? 0 : baseline->fields[field];
+        snapshot.fields[field] = base;
+        if ((changed & (1u << field)) == 0) {
+            continue;
+        }
+        Uint32 small, value;
+        if (!getBits(reader, 1, small)) {
+            return false;
+        }
+        if (small) {
+            if (!getBits(reader, SMALL_DELTA_BITS, value)) {
+                return false;
+            }
+            // Sign-extend the delta
+            int delta = static_cast<int>(value << (32 - SMALL_DELTA_BITS)) >> (32 - SMALL_DELTA_BITS);
+            snapshot.fields[field] = static_cast<Uint16>(base + delta);
+        }
+        else {
+            if (!getBits(reader, FIELD_BITS[field], value)) {
+                return false;
+            }
+            snapshot.fields[field] = static_cast<Uint16>(value);
+        }
+    }
+    return true;
+}
+
+bool openSpectatorServer(SpectatorServer& server, Uint16 port) {
+    server.connections.clear();
+    std::memset(&server.stats, 0, sizeof(server.stats));
+    server.listener = openTcpListener(port);
+    return server.listener != NET_NO_SOCKET;
+}
+
+void closeSpectatorServer(SpectatorServer& server) {
+    for (SpectatorConnection& connection : server.connections) {
+        closeTcp(connection.handle);
+    }
+    server.connections.clear();
+    closeTcp(server.listener);
+    server.listener = NET_NO_SOCKET;
+}
+
+void acceptSpectators(SpectatorServer& server) {
+    if (server.listener == NET_NO_SOCKET) {
+        return;
+    }
+    while (static_cast<int>(server.connections.size()) < SPECTATOR_MAX_CLIENTS) {
+        NetSocketHandle handle = acceptTcpConnection(server.listener);
+        if (handle == NET_NO_SOCKET) {
+            break;
+        }
+        SpectatorConnection connection;
+        connection.handle = handle;
+        connection.hasBaseline = false;
+        std::memset(&connection.baseline, 0, sizeof(connection.baseline));
+        server.connections.push_back(connection);
+    }
+}
+
+// Function to push out bytes a spectator's socket refused earlier, false if the spectator is gone
+static bool flushPending(SpectatorConnection& connection) {
+    if (connection.pending.empty()) {
+        return true;
+    }
+    int sent = tcpSend(connection.handle, connection.pending.data(), static_cast<int>(connection.pending.size()));
+    if (sent < 0) {
+        return false;
+    }
+    connection.pending.erase(connection.pending.begin(), connection.pending.begin() + sent);
+    return true;
+}
+
+void broadcastSnapshot(SpectatorServer& server, Uint32 tick) {
+    Uint64 start = SDL_GetPerformanceCounter();
+    acceptSpectators(server);
+
+    SpectatorSnapshot snapshot;
+    captureSnapshot(snapshot, tick);
+
+    // Spectators that are keeping up all share a baseline, so each distinct baseline is encoded once.
+    // Kept across calls so steady-state broadcasts don't allocate.
+    static std::vector<Uint32> cachedBaselines;
+    static std::vector<std::vector<Uint8>> cachedMessages;
+    size_t cacheSize = 0;
+    const Uint32 keyframeKey = 0xFFFFFFFFu;
+
+    for (size_t i = 0; i < server.connections.size();) {
+        SpectatorConnection& connection = server.connections[i];
+        bool alive = flushPending(connection);
+        if (alive && !connection.pending.empty()) {
+            ++server.stats.skipped;
+        }
+        else if (alive) {
+            Uint32 key = connection.hasBaseline ? connection.baseline.tick : keyframeKey;
+            size_t entry = 0;
+            while (entry < cacheSize && cachedBaselines[entry] != key) {
+                ++entry;
+            }
+            if (entry == cacheSize) {
+                if (cacheSize == cachedMessages.size()) {
+                    cachedBaselines.push_back(0);
+                    cachedMessages.push_back(std::vector<Uint8>());
+                }
+                cachedBaselines[entry] = key;
+                encodeSnapshot(cachedMessages[entry], snapshot, connection.hasBaseline ? &connection.baseline : nullptr);
+                ++cacheSize;
+                ++server.stats.encodes;
+            }
+            const std::vector<Uint8>& message = cachedMessages[entry];
+
+            int sent = tcpSend(connection.handle, message.data(), static_cast<int>(message.size()));
+            if (sent < 0) {
+                alive = false;
+            }
+            else {
+                if (sent < static_cast<int>(message.size())) {
+                    connection.pending.assign(message.begin() + sent, message.end());
+                }
+                connection.baseline = snapshot;
+                connection.hasBaseline = true;
+                ++server.stats.snapshots;
+                server.stats.bytes += message.size();
+            }
+        }
+
+        if (!alive) {
+            closeTcp(connection.handle);
+            server.connections[i] = server.connections.back();
+            server.connections.pop_back();
+            continue;
+        }
+        ++i;
+    }
+
+    Uint64 elapsed = SDL_GetPerformanceCounter() - start;
+    server.stats.broadcastCounter += elapsed;
+    if (elapsed > server.stats.maxBroadcastCounter) {
+        server.stats.maxBroadcastCounter = elapsed;
+    }
+}
+
+bool connectSpectator(SpectatorClient& client, const char* host, Uint16 port) {
+    client.inbox.clear();
+    client.count = 0;
+    client.newestArrivalMs = 0;
+    client.handle = connectTcp(host, port);
+    return client.handle != NET_NO_SOCKET;
+}
+
+void closeSpectator(SpectatorClient& client) {
+    closeTcp(client.handle);
+    client.handle = NET_NO_SOCKET;
+}
+
+const SpectatorSnapshot* newestSnapshot(const SpectatorClient& client) {
+    return client.count == 0 ? nullptr : &client.history[(client.count - 1) & (SPECTATOR_HISTORY - 1)];
+}
+
+bool pollSpectator(SpectatorClient& client, Uint32 nowMs) {
+    if (client.handle == NET_NO_SOCKET) {
+        return false;
+    }
+    Uint8 buffer[16384];
+    int received;
+    while ((received = tcpReceive(client.handle, buffer, sizeof(buffer))) > 0) {
+        client.inbox.insert(client.inbox.end(), buffer, buffer + received);
+    }
+    bool alive = received == 0;
+
+    size_t offset = 0;
+    while (client.inbox.size() - offset >= 2) {
+        size_t size = client.inbox[offset] | (client.inbox[offset + 1] << 8);
+        if (client.inbox.size() - offset - 2 < size) {
+            break;
+        }
+        SpectatorSnapshot& slot = client.history[client.count & (SPECTATOR_HISTORY - 1)];
+        if (!decodeSnapshot(&client.inbox[offset + 2], size, newestSnapshot(client), slot)) {
+            std::cerr << "Spectator stream is corrupt!" << std::endl;
+            alive = false;
+            break;
+        }
+        ++client.count;
+        client.newestArrivalMs = nowMs;
+        offset += 2 + size;
+    }
+    client.inbox.erase(client.inbox.begin(), client.inbox.begin() + offset);
+    return alive;
+}
+
+void interpolateSpectator(const SpectatorClient& client, Uint32 nowMs) {
+    if (client.count == 0) {
+        return;
+    }
+    const int mask = SPECTATOR_HISTORY - 1;
+    const SpectatorSnapshot& newest = client.history[(client.count - 1) & mask];
+
+    // Where the game was SPECTATOR_INTERPOLATION_MS ago, estimated from when the newest snapshot arrived
+    float renderTick = newest.tick + static_cast<float>(nowMs - client.newestArrivalMs) / TICK_MS -
+        static_cast<float>(SPECTATOR_INTERPOLATION_MS) / TICK_MS;
+
+    int oldest = client.count > SPECTATOR_HISTORY ? client.count - SPECTATOR_HISTORY : 0;
+    int index = client.count - 1;
+    while (index > oldest && client.history[index & mask].tick > renderTick) {
+        --index;
+    }
+    const SpectatorSnapshot& a = client.history[index & mask];
+    const SpectatorSnapshot& b = index + 1 < client.count ? client.history[(index + 1) & mask] : a;
+    float t = 0.0f;
+    if (b.tick > a.tick) {
+        t = (renderTick - a.tick) / (b.tick - a.tick);
+        t = t < 0.0f ? 0.0f : (t > 1.0f ? 1.0f : t);
+    }
+
+    float ax = dequantise(SNAPSHOT_BALL_X, a.fields[SNAPSHOT_BALL_X]);
+    float ay = dequantise(SNAPSHOT_BALL_Y, a.fields[SNAPSHOT_BALL_Y]);
+    float bx = dequantise(SNAPSHOT_BALL_X, b.fields[SNAPSHOT_BALL_X]);
+    float by = dequantise(SNAPSHOT_BALL_Y, b.fields[SNAPSHOT_BALL_Y]);
+    // A serve teleports the ball; blending across it would slide the ball through the field
+    float jumpLimit = 4.0f * ClassicConfig::ballSpeedX * (b.tick - a.tick + 1);
+    if (std::fabs(bx - ax) > jumpLimit || std::fabs(by - ay) > jumpLimit) {
+        t = t < 1.0f ? 0.0f : 1.0f;
+    }
+    ball.x = ax + (bx - ax) * t;
+    ball.y = ay + (by - ay) * t;
+    ball.r = ClassicConfig::ballRadius;
+    ball.dx = dequantise(SNAPSHOT_BALL_DX, a.fields[SNAPSHOT_BALL_DX]);
+    ball.dy = dequantise(SNAPSHOT_BALL_DY, a.fields[SNAPSHOT_BALL_DY]);
+
+    // Blend the spin the short way round
+    float angleA = dequantise(SNAPSHOT_BALL_ANGLE, a.fields[SNAPSHOT_BALL_ANGLE]);
+    float angleB = dequantise(SNAPSHOT_BALL_ANGLE, b.fields[SNAPSHOT_BALL_ANGLE]);
+    float turn = std::fmod(angleB - angleA + 540.0f, 360.0f) - 180.0f;
+    ball.angle = angleA + turn * t;
+
+    float leftA = dequantise(SNAPSHOT_LEFT_Y, a.fields[SNAPSHOT_LEFT_Y]);
+    float rightA = dequantise(SNAPSHOT_RIGHT_Y, a.fields[SNAPSHOT_RIGHT_Y]);
+    leftPaddle.y = static_cast<int>(std::lround(leftA + (dequantise(SNAPSHOT_LEFT_Y, b.fields[SNAPSHOT_LEFT_Y]) - leftA) * t));
+    rightPaddle.y = static_cast<int>(std::lround(rightA + (dequantise(SNAPSHOT_RIGHT_Y, b.fields[SNAPSHOT_RIGHT_Y]) - rightA) * t));
+
+    const SpectatorSnapshot& scores = t < 1.0f ? a : b;
+    leftScore = scores.fields[SNAPSHOT_LEFT_SCORE];
+    rightScore = scores.fields[SNAPSHOT_RIGHT_SCORE];
+}
+
+bool runSpectatorBenchmark(int spectators, int ticks, Uint16 port) {
+    if (!initializeNetwork()) {
+        return false;
+    }
+#ifndef _WIN32
+    // Every spectator costs two descriptors in this process
+    rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+        rlim_t wanted = static_cast<rlim_t>(spectators) * 2 + 64;
+        if (limit.rlim_cur < wanted) {
+            limit.rlim_cur = wanted < limit.rlim_max ? wanted : limit.rlim_max;
+            setrlimit(RLIMIT_NOFILE, &limit);
+        }
+    }
+#endif
+
+    SpectatorServer server;
+    if (!openSpectatorServer(server, port)) {
+        shutdownNetwork();
+        return false;
+    }
+
+    // Accept as we go so the listen backlog never overflows
+    std::vector<SpectatorClient> clients(spectators);
+    int connected = 0;
+    while (connected < spectators && connectSpectator(clients[connected], "127.0.0.1", port)) {
+        ++connected;
+        acceptSpectators(server);
+    }
+    for (int attempt = 0; attempt < 100 && static_cast<int>(server.connections.size()) < connected; ++attempt) {
+        SDL_Delay(1);
+        acceptSpectators(server);
+    }
+    clients.resize(connected);
+
+    resetPaddles();
+    leftScore = 0;
+    rightScore = 0;
+    servePauseMs = 0;
+    resetBall(true);
+    AiController ais[2];
+    initAi(ais[0], 6, 30.0f, 21);
+    initAi(ais[1], 10, 50.0f, 22);
+
+    Uint64 clientCounter = 0;
+    for (int tick = 0; tick < ticks; ++tick) {
+        bool leftUp, leftDown, rightUp, rightDown;
+        aiDecide(ais[0], ball, leftPaddle, true, leftUp, leftDown);
+        aiDecide(ais[1], ball, rightPaddle, false, rightUp, rightDown);
+        movePaddle(leftPaddle, leftUp, leftDown);
+        movePaddle(rightPaddle, rightUp, rightDown);
+        update();
+
+        broadcastSnapshot(server, tick);
+
+        Uint64 start = SDL_GetPerformanceCounter();
+        for (SpectatorClient& client : clients) {
+            pollSpectator(client, tick * TICK_MS);
+        }
+        clientCounter += SDL_GetPerformanceCounter() - start;
+    }
+
+    // Every spectator that kept up must have decoded exactly what the server quantised last
+    SpectatorSnapshot expected;
+    captureSnapshot(expected, ticks - 1);
+    int inSync = 0;
+    for (int drain = 0; drain < 10; ++drain) {
+        SDL_Delay(1);
+        for (SpectatorClient& client : clients) {
+            pollSpectator(client, ticks * TICK_MS);
+        }
+    }
+    for (SpectatorClient& client : clients) {
+        const SpectatorSnapshot* newest = newestSnapshot(client);
+        if (newest != nullptr && newest->tick == expected.tick &&
+            std::memcmp(newest->fields, expected.fields, sizeof(expected.fields)) == 0) {
+            ++inSync;
+        }
+    }
+
+    const SpectatorServerStats& stats = server.stats;
+    double frequency = static_cast<double>(SDL_GetPerformanceFrequency());
+    double gameSeconds = ticks * TICK_MS / 1000.0;
+    double serverSeconds = stats.broadcastCounter / frequency;
+    std::cout << "Spectator benchmark: " << connected << " spectators over loopback TCP, " << ticks << " ticks ("
+        << gameSeconds << " s of play)" << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "  bandwidth:  " << (connected > 0 ? stats.bytes / gameSeconds / connected : 0.0) << " bytes/s per spectator, "
+        << (stats.snapshots > 0 ? static_cast<double>(stats.bytes) / stats.snapshots : 0.0) << " bytes/snapshot, "
+        << stats.bytes / gameSeconds / 1024.0 << " KiB/s total" << std::endl;
+    std::cout << "  server:     " << serverSeconds * 1e6 / ticks << " us/tick average, " << stats.maxBroadcastCounter * 1e6 / frequency
+        << " us worst, " << serverSeconds / gameSeconds * 100.0 << "% of one core at " << 1000 / TICK_MS << " ticks/s" << std::endl;
+    std::cout << "  encoding:   " << stats.encodes << " encodes for " << stats.snapshots << " snapshots, " << stats.skipped
+        << " skipped for back-pressure" << std::endl;
+    std::cout << "  clients:    " << clientCounter * 1e6 / frequency / ticks << " us/tick decoding all spectators, "
+        << inSync << "/" << connected << " match the final state" << std::endl;
+    std::cout.unsetf(std::ios::fixed);
+
+    for (SpectatorClient& client : clients) {
+        closeSpectator(client);
+    }
+    closeSpectatorServer(server);
+    shutdownNetwork();
+    return connected == spectators && inSync == connected;
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include "net.h"
+#include <vector>
+
+// Most spectators one game serves
+const int SPECTATOR_MAX_CLIENTS = 1024;
+// How far behind the newest snapshot spectators render, so there is usually a later one to blend towards
+const int SPECTATOR_INTERPOLATION_MS = 50;
+// Snapshots a spectator keeps for interpolation (power of two)
+const int SPECTATOR_HISTORY = 32;
+
+// Quantised game state fields, in wire order
+enum SnapshotField {
+    SNAPSHOT_BALL_X,        // 1/8 px
+    SNAPSHOT_BALL_Y,
+    SNAPSHOT_BALL_DX,       // 1/64 px per tick
+    SNAPSHOT_BALL_DY,
+    SNAPSHOT_BALL_ANGLE,    // 1/2 degree
+    SNAPSHOT_LEFT_Y,        // px
+    SNAPSHOT_RIGHT_Y,
+    SNAPSHOT_LEFT_SCORE,
+    SNAPSHOT_RIGHT_SCORE,
+    SNAPSHOT_FIELD_COUNT
+};
+
+// Game state as spectators see it
+struct SpectatorSnapshot {
+    Uint32 tick;
+    Uint16 fields[SNAPSHOT_FIELD_COUNT];
+};
+
+// Function to quantise the game globals
+void captureSnapshot(SpectatorSnapshot& snapshot, Uint32 tick);
+
+// One connected spectator as the game sees it
+struct SpectatorConnection {
+    NetSocketHandle handle;
+    std::vector<Uint8> pending;     // bytes the socket didn't take yet
+    SpectatorSnapshot baseline;     // last snapshot queued, which TCP will deliver before anything newer
+    bool hasBaseline;
+};
+
+// Counters for the spectator benchmark
+struct SpectatorServerStats {
+    Uint64 snapshots;           // snapshots queued across all spectators
+    Uint64 skipped;             // snapshots not sent because a spectator's socket was still backed up
+    Uint64 bytes;
+    Uint64 encodes;             // distinct encodings (spectators sharing a baseline share one)
+    Uint64 broadcastCounter;    // SDL performance counter ticks spent in broadcastSnapshot()
+    Uint64 maxBroadcastCounter;
+};
+
+// Game side: a listener plus every connected spectator
+struct SpectatorServer {
+    NetSocketHandle listener;
+    std::vector<SpectatorConnection> connections;
+    SpectatorServerStats stats;
+};
+
+// Function to start listening for spectators
+bool openSpectatorServer(SpectatorServer& server, Uint16 port);
+void closeSpectatorServer(SpectatorServer& server);
+
+// Function to accept every waiting spectator
+void acceptSpectators(SpectatorServer& server);
+
+// Function to send the current game state to every spectator as a delta against the last
+// snapshot it was sent; spectators whose socket is backed up skip ticks until it drains
+void broadcastSnapshot(SpectatorServer& server, Uint32 tick);
+
+// Spectator side: decodes the stream and keeps recent snapshots for interpolation
+struct SpectatorClient {
+    NetSocketHandle handle;
+    std::vector<Uint8> inbox;       // received bytes not yet decoded
+    SpectatorSnapshot history[SPECTATOR_HISTORY];
+    int count;                      // snapshots received
+    Uint32 newestArrivalMs;         // local time the newest snapshot arrived
+};
+
+// Function to connect to a game
+bool connectSpectator(SpectatorClient& client, const char* host, Uint16 port);
+void closeSpectator(SpectatorClient& client);
+
+// Function to decode everything that has arrived, returns false once the game has gone away
+bool pollSpectator(SpectatorClient& client, Uint32 nowMs);
+
+// Function to get the newest decoded snapshot, nullptr before the first one
+const SpectatorSnapshot* newestSnapshot(const SpectatorClient& client);
+
+// Function to write the state SPECTATOR_INTERPOLATION_MS in the past, blended between the
+// two snapshots around it, into the game globals for render()
+void interpolateSpectator(const SpectatorClient& client, Uint32 nowMs);
+
+// Function to serve a headless AI match to many spectators over loopback and report bandwidth and server CPU
+bool runSpectatorBenchmark(int spectators, int ticks, Uint16 port);
@@ -0,0 +1,94 @@
+#include "spritebatch.h"
+#include "raster.h"
+#include <vector>
+
+// Quads queued for one atlas page; capacity is kept between frames
+struct PageBatch {
+    std::vector<SDL_Vertex> vertices;
+    std::vector<int> indices;
+};
+
+static PageBatch batches[ATLAS_MAX_PAGES];
+static int lastDrawCalls = 0;
+
+void batchSprite(const AtlasSprite& sprite, const SDL_Rect& dst, SDL_Color color) {
+    SDL_Texture* texture = atlasPageTexture(sprite.page);
+    if (texture == nullptr) {
+        return;
+    }
+    PageBatch& batch = batches[sprite.page];
+
+    float u0 = static_cast<float>(sprite.rect.x) / ATLAS_PAGE_SIZE;
+    float v0 = static_cast<float>(sprite.rect.y) / ATLAS_PAGE_SIZE;
+    float u1 = static_cast<float>(sprite.rect.x + sprite.rect.w) / ATLAS_PAGE_SIZE;
+    float v1 = static_cast<float>(sprite.rect.y + sprite.rect.h) / ATLAS_PAGE_SIZE;
+    float x0 = static_cast<float>(dst.x);
+    float y0 = static_cast<float>(dst.y);
+    float x1 = static_cast<float>(dst.x + dst.w);
+    float y1 = static_cast<float>(dst.y + dst.h);
+
+    int base = static_cast<int>(batch.vertices.size());
+    batch.vertices.push_back({ { x0, y0 }, color, { u0, v0 } });
+    batch.vertices.push_back({ { x1, y0 }, color, { u1, v0 } });
+    batch.vertices.push_back({ { x1, y1 }, color, { u1, v1 } });
+    batch.vertices.push_back({ { x0, y1 }, color, { u0, v1 } });
+    int quad[6] = { base, base + 1, base + 2, base, base + 2, base + 3 };
+    batch.indices.insert(batch.indices.end(), quad, quad + 6);
+}
+
+void batchFillRect(const SDL_Rect& dst, SDL_Color color) {
+    batchSprite(atlasWhiteSprite(), dst, color);
+}
+
+void batchText(AtlasFont font, const char* text, int x, int y, SDL_Color color) {
+    int penX = x;
+    for (const char* c = text; *c != '\0'; ++c) {
+        int advance = 0;
+        const AtlasSprite* glyph = atlasGlyph(font, *c, &advance);
+        if (glyph != nullptr) {
+            SDL_Rect dst = { penX, y, glyph->rect.w, glyph->rect.h };
+            batchSprite(*glyph, dst, color);
+        }
+        penX += advance;
+    }
+}
+
+void flushSpriteBatch(SDL_Renderer* renderer) {
+    lastDrawCalls = 0;
+    for (int page = 0; page < ATLAS_MAX_PAGES; ++page) {
+        PageBatch& batch = batches[page];
+        if (batch.indices.empty()) {
+            continue;
+        }
+        SDL_RenderGeometry(renderer, atlasPageTexture(page), batch.vertices.data(), static_cast<int>(batch.vertices.size()),
+            batch.indices.data(), static_cast<int>(batch.indices.size()));
+        ++lastDrawCalls;
+        batch.vertices.clear();
+        batch.indices.clear();
+    }
+}
+
+void flushSpriteBatchToRaster(RasterFrame& frame) {
+    for (int page = 0; page < ATLAS_MAX_PAGES; ++page) {
+        PageBatch& batch = batches[page];
+        // Every quad is four corners, clockwise from the top-left
+        for (size_t i = 0; i + 3 < batch.vertices.size(); i += 4) {
+            const SDL_Vertex& topLeft = batch.vertices[i];
+            const SDL_Vertex& bottomRight = batch.vertices[i + 2];
+            AtlasSprite sprite = { page, {
+                static_cast<int>(topLeft.tex_coord.x * ATLAS_PAGE_SIZE + 0.5f),
+                static_cast<int>(topLeft.tex_coord.y * ATLAS_PAGE_SIZE + 0.5f),
+                static_cast<int>((bottomRight.tex_coord.x - topLeft.tex_coord.x) * ATLAS_PAGE_SIZE + 0.5f),
+                static_cast<int>((bottomRight.tex_coord.y - topLeft.tex_coord.y) * ATLAS_PAGE_SIZE + 0.5f) } };
+            SDL_Rect dst = { static_cast<int>(topLeft.position.x), static_cast<int>(topLeft.position.y),
+                static_cast<int>(bottomRight.position.x - topLeft.position.x), static_cast<int>(bottomRight.position.y - topLeft.position.y) };
+            rasterSprite(frame, sprite, dst, topLeft.color);
+        }
+        batch.vertices.clear();
+        batch.indices.clear();
+    }
+}
+
+int spriteBatchDrawCalls() {
+    return lastDrawCalls;
+}
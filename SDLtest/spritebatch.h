@@ -0,0 +1,21 @@
+#pragma once
+#include "atlas.h"
+
+// Function to queue a textured quad from the atlas, tinted by color
+void batchSprite(const AtlasSprite& sprite, const SDL_Rect& dst, SDL_Color color);
+
+// Function to queue a solid-colour rectangle through the white atlas texel
+void batchFillRect(const SDL_Rect& dst, SDL_Color color);
+
+// Function to queue a string with its top-left corner at (x, y)
+void batchText(AtlasFont font, const char* text, int x, int y, SDL_Color color);
+
+// Function to draw everything queued this frame, one SDL_RenderGeometry call per atlas page
+void flushSpriteBatch(SDL_Renderer* renderer);
+
+// Function to hand everything queued this frame to the offline rasterizer instead of SDL
+struct RasterFrame;
+void flushSpriteBatchToRaster(RasterFrame& frame);
+
+// Function to get how many SDL_RenderGeometry calls the last flush issued
+int spriteBatchDrawCalls();
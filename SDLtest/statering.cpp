@@ -0,0 +1,50 @@
+#include "statering.h"
+#include <iomanip>
+#include <iostream>
+
+// Static so the ring gets its 64-byte alignment without aligned new
+static StateRing benchmarkRing;
+// Where the restore loop's checksum goes, so the loads can't be optimised away
+static volatile float benchmarkSink;
+
+void runSnapshotBenchmark(int count) {
+    resetPaddles();
+    servePauseMs = 0;
+    resetBall(true);
+    double frequency = static_cast<double>(SDL_GetPerformanceFrequency());
+
+    // Save: change the state a little each time so every snapshot is a real copy
+    Uint64 start = SDL_GetPerformanceCounter();
+    for (int i = 0; i < count; ++i) {
+        ball.x += 1.0f;
+        saveStateAt(benchmarkRing, static_cast<Uint32>(i));
+    }
+    double saveSeconds = (SDL_GetPerformanceCounter() - start) / frequency;
+
+    // Restore: walk the ring out of order and read something back so the loads can't be dropped
+    float checksum = 0.0f;
+    start = SDL_GetPerformanceCounter();
+    for (int i = 0; i < count; ++i) {
+        loadStateAt(benchmarkRing, static_cast<Uint32>(i) * 7);
+        checksum += ball.x;
+    }
+    double restoreSeconds = (SDL_GetPerformanceCounter() - start) / frequency;
+    benchmarkSink = checksum;
+
+    // Round trip as rollback uses it: restore an old tick, step, save the next one
+    start = SDL_GetPerformanceCounter();
+    for (int i = 0; i < count; ++i) {
+        loadStateAt(benchmarkRing, static_cast<Uint32>(i));
+        ball.y += ball.dy;
+        saveStateAt(benchmarkRing, static_cast<Uint32>(i) + 1);
+    }
+    double roundTripSeconds = (SDL_GetPerformanceCounter() - start) / frequency;
+
+    std::cout << "Snapshot benchmark: " << count << " snapshots of " << sizeof(GameState) << " bytes (alignment "
+        << alignof(GameState) << "), ring of " << STATE_RING_SIZE << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "  save:         " << count / saveSeconds / 1e6 << " M/s (" << saveSeconds * 1e9 / count << " ns)" << std::endl;
+    std::cout << "  restore:      " << count / restoreSeconds / 1e6 << " M/s (" << restoreSeconds * 1e9 / count << " ns)" << std::endl;
+    std::cout << "  restore+save: " << count / roundTripSeconds / 1e6 << " M/s (" << roundTripSeconds * 1e9 / count << " ns)" << std::endl;
+    std::cout.unsetf(std::ios::fixed);
+}
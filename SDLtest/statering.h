@@ -0,0 +1,28 @@
+#pragma once
+#include "game.h"
+
+// Game states kept by a ring (power of two), enough for the rollback window and short rewinds
+const int STATE_RING_SIZE = 256;
+
+// Preallocated game states indexed by tick; a tick's slot is reused STATE_RING_SIZE ticks later
+struct StateRing {
+    GameState slots[STATE_RING_SIZE];
+};
+
+// Function to store the current game state as the state of a tick
+inline void saveStateAt(StateRing& ring, Uint32 tick) {
+    std::memcpy(&ring.slots[tick & (STATE_RING_SIZE - 1)], &gameState, sizeof(GameState));
+}
+
+// Function to put the game back to the state stored for a tick
+inline void loadStateAt(const StateRing& ring, Uint32 tick) {
+    std::memcpy(&gameState, &ring.slots[tick & (STATE_RING_SIZE - 1)], sizeof(GameState));
+}
+
+// Function to look at a stored state without restoring it
+inline const GameState& stateAt(const StateRing& ring, Uint32 tick) {
+    return ring.slots[tick & (STATE_RING_SIZE - 1)];
+}
+
+// Function to time saving and restoring snapshots through a ring and print the rates
+void runSnapshotBenchmark(int count);
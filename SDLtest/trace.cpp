@@ -0,0 +1,159 @@
+#include "trace.h"
+#include <cstdio>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+// One recorded event; the timestamp is a raw performance counter value
+struct TraceRecord {
+    const char* name;
+    Uint64 counter;
+    TracePhase phase;
+};
+
+// Single-producer single-consumer ring: the owning thread appends, flushTrace() drains
+struct TraceBuffer {
+    TraceRecord records[TRACE_BUFFER_EVENTS];
+    std::atomic<unsigned> head;     // next slot the owner writes
+    std::atomic<unsigned> tail;     // next slot the flush reads
+    std::atomic<Uint32> dropped;
+    int threadId;
+    const char* threadName;         // guarded by registryMutex
+};
+
+std::atomic<bool> traceEnabled(false);
+
+// Every thread that has traced gets a buffer for the rest of the run: a thread may still hold
+// its pointer after the trace stops, so buffers are never freed
+static std::mutex registryMutex;
+static std::vector<TraceBuffer*> buffers;
+static thread_local TraceBuffer* threadBuffer = nullptr;
+
+static FILE* traceFile = nullptr;
+static const char* tracePath = nullptr;
+static Uint64 traceStartCounter = 0;
+static double microsecondsPerCount = 0.0;
+static Uint64 eventsWritten = 0;
+static bool firstEntry = true;
+
+// Function to get the separator that goes before the next object in the event array
+static const char* nextEntry() {
+    const char* separator = firstEntry ? "" : ",\n";
+    firstEntry = false;
+    return separator;
+}
+
+// Function to get the calling thread's buffer, registering one on first use
+static TraceBuffer* ownBuffer() {
+    if (threadBuffer == nullptr) {
+        TraceBuffer* buffer = new TraceBuffer();
+        buffer->head = 0;
+        buffer->tail = 0;
+        buffer->dropped = 0;
+        buffer->threadName = nullptr;
+        std::lock_guard<std::mutex> lock(registryMutex);
+        buffer->threadId = static_cast<int>(buffers.size()) + 1;
+        buffers.push_back(buffer);
+        threadBuffer = buffer;
+    }
+    return threadBuffer;
+}
+
+void traceEvent(TracePhase phase, const char* name) {
+    TraceBuffer* buffer = ownBuffer();
+    unsigned head = buffer->head.load(std::memory_order_relaxed);
+    if (head - buffer->tail.load(std::memory_order_acquire) == TRACE_BUFFER_EVENTS) {
+        buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    TraceRecord& record = buffer->records[head & (TRACE_BUFFER_EVENTS - 1)];
+    record.name = name;
+    record.counter = SDL_GetPerformanceCounter();
+    record.phase = phase;
+    buffer->head.store(head + 1, std::memory_order_release);
+}
+
+void traceThreadName(const char* name) {
+    if (!traceActive()) {
+        return;
+    }
+    TraceBuffer* buffer = ownBuffer();
+    if (buffer->threadName == name) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(registryMutex);
+    buffer->threadName = name;
+}
+
+// Function to write one event object
+static void writeRecord(const TraceRecord& record, int threadId) {
+    double timestamp = static_cast<double>(record.counter - traceStartCounter) * microsecondsPerCount;
+    std::fprintf(traceFile, "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%d%s}",
+        nextEntry(), record.name, static_cast<char>(record.phase), timestamp, threadId,
+        record.phase == TracePhase::INSTANT ? ",\"s\":\"t\"" : "");
+    ++eventsWritten;
+}
+
+bool startTrace(const char* path) {
+    traceFile = std::fopen(path, "w");
+    if (traceFile == nullptr) {
+        std::cerr << "Unable to open " << path << " for the trace!" << std::endl;
+        return false;
+    }
+    tracePath = path;
+    std::fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", traceFile);
+    traceStartCounter = SDL_GetPerformanceCounter();
+    microsecondsPerCount = 1000000.0 / static_cast<double>(SDL_GetPerformanceFrequency());
+    eventsWritten = 0;
+    firstEntry = true;
+    traceEnabled = true;
+    traceThreadName("main");
+    return true;
+}
+
+void flushTrace() {
+    if (traceFile == nullptr) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (TraceBuffer* buffer : buffers) {
+        unsigned tail = buffer->tail.load(std::memory_order_relaxed);
+        unsigned head = buffer->head.load(std::memory_order_acquire);
+        for (; tail != head; ++tail) {
+            writeRecord(buffer->records[tail & (TRACE_BUFFER_EVENTS - 1)], buffer->threadId);
+        }
+        buffer->tail.store(tail, std::memory_order_release);
+    }
+}
+
+void stopTrace() {
+    if (traceFile == nullptr) {
+        return;
+    }
+    traceEnabled = false;
+    flushTrace();
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+    Uint64 dropped = 0;
+    for (TraceBuffer* buffer : buffers) {
+        if (buffer->threadName != nullptr) {
+            std::fprintf(traceFile, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                nextEntry(), buffer->threadId, buffer->threadName);
+        }
+        dropped += buffer->dropped.exchange(0);
+    }
+    std::fputs("\n]}\n", traceFile);
+    bool written = std::ferror(traceFile) == 0;
+    written = std::fclose(traceFile) == 0 && written;
+    traceFile = nullptr;
+
+    if (!written) {
+        std::cerr << "Failed writing the trace to " << tracePath << "!" << std::endl;
+        return;
+    }
+    std::cout << "Trace: " << eventsWritten << " events from " << buffers.size() << " threads written to " << tracePath;
+    if (dropped > 0) {
+        std::cout << ", " << dropped << " dropped on full buffers";
+    }
+    std::cout << std::endl;
+}
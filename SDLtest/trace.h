@@ -0,0 +1,62 @@
+#pragma once
+#include <SDL.h>
+#include <atomic>
+
+// Events each thread can hold between flushes; a full buffer drops new events and counts them
+const int TRACE_BUFFER_EVENTS = 1 << 15; // power of two
+
+// Chrome trace event phases
+enum class TracePhase : char {
+    BEGIN = 'B',
+    END = 'E',
+    INSTANT = 'i'
+};
+
+// Set while a trace is being recorded, so disabled spans cost one relaxed load
+extern std::atomic<bool> traceEnabled;
+
+inline bool traceActive() {
+    return traceEnabled.load(std::memory_order_relaxed);
+}
+
+// Function to append an event to the calling thread's buffer. The name must be a string literal:
+// only the pointer is stored and it is written to the file as is.
+void traceEvent(TracePhase phase, const char* name);
+
+// Function to label the calling thread in the trace viewer (string literal, like event names)
+void traceThreadName(const char* name);
+
+// Begin/end pair around a scope
+struct TraceScope {
+    explicit TraceScope(const char* name) : name(traceActive() ? name : nullptr) {
+        if (this->name != nullptr) {
+            traceEvent(TracePhase::BEGIN, this->name);
+        }
+    }
+    ~TraceScope() {
+        if (name != nullptr) {
+            traceEvent(TracePhase::END, name);
+        }
+    }
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+    const char* name;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+// Span from here to the end of the enclosing block
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+// Zero-length marker on the calling thread
+#define TRACE_INSTANT(name) do { if (traceActive()) { traceEvent(TracePhase::INSTANT, name); } } while (0)
+
+// Function to open a Chrome/Perfetto trace file (JSON trace event format) and start recording
+bool startTrace(const char* path);
+
+// Function to move every thread's buffered events to the file; call it once per frame from the main thread
+void flushTrace();
+
+// Function to flush the remaining events, name the threads, close the file and print a summary.
+// A trace cut short without this still loads, the viewers accept an unterminated event array.
+void stopTrace();
@@ -0,0 +1,95 @@
+#include "windowstate.h"
+#include "dirtyrect.h"
+#include <iostream>
+
+static const char* STATE_NAMES[static_cast<int>(WindowState::COUNT)] = { "focused", "unfocused", "hidden" };
+
+static bool focused = true;
+static bool hidden = false;
+static WindowState state = WindowState::FOCUSED;
+static Uint32 stateSinceMs = 0;
+static Uint32 stateMs[static_cast<int>(WindowState::COUNT)];
+static Uint32 lastFrameMs = 0;
+static Uint32 framesSkipped = 0;
+
+// Function to move to whatever state the flags now describe, adding up the time spent in the old one
+static void updateState() {
+    WindowState next = hidden ? WindowState::HIDDEN : (focused ? WindowState::FOCUSED : WindowState::UNFOCUSED);
+    if (next == state) {
+        return;
+    }
+    Uint32 now = SDL_GetTicks();
+    stateMs[static_cast<int>(state)] += now - stateSinceMs;
+    stateSinceMs = now;
+    state = next;
+}
+
+void windowStateEvent(const SDL_WindowEvent& e) {
+    switch (e.event) {
+    case SDL_WINDOWEVENT_SHOWN:
+    case SDL_WINDOWEVENT_EXPOSED:
+    case SDL_WINDOWEVENT_RESTORED:
+    case SDL_WINDOWEVENT_MAXIMIZED:
+    case SDL_WINDOWEVENT_SIZE_CHANGED:
+        hidden = false;
+        // The window may have lost what was last presented; partial presents would leave holes
+        repaintWholeWindow();
+        break;
+    case SDL_WINDOWEVENT_HIDDEN:
+    case SDL_WINDOWEVENT_MINIMIZED:
+        hidden = true;
+        break;
+    case SDL_WINDOWEVENT_FOCUS_GAINED:
+        focused = true;
+        break;
+    case SDL_WINDOWEVENT_FOCUS_LOST:
+        focused = false;
+        break;
+    default:
+        return;
+    }
+    updateState();
+}
+
+WindowState windowState() {
+    return state;
+}
+
+bool windowVisible() {
+    return state != WindowState::HIDDEN;
+}
+
+bool windowFrameDue() {
+    Uint32 now = SDL_GetTicks();
+    bool due = state == WindowState::FOCUSED || (state == WindowState::UNFOCUSED && now - lastFrameMs >= UNFOCUSED_FRAME_MS);
+    if (due) {
+        lastFrameMs = now;
+    }
+    else {
+        ++framesSkipped;
+    }
+    return due;
+}
+
+void waitWhileHidden() {
+    if (state == WindowState::HIDDEN) {
+        SDL_WaitEventTimeout(nullptr, HIDDEN_WAIT_MS);
+    }
+}
+
+void reportWindowStates() {
+    Uint32 totals[static_cast<int>(WindowState::COUNT)];
+    for (int i = 0; i < static_cast<int>(WindowState::COUNT); ++i) {
+        totals[i] = stateMs[i];
+    }
+    totals[static_cast<int>(state)] += SDL_GetTicks() - stateSinceMs;
+    // Nothing to say about a window that stayed in front throughout
+    if (totals[static_cast<int>(WindowState::UNFOCUSED)] == 0 && totals[static_cast<int>(WindowState::HIDDEN)] == 0) {
+        return;
+    }
+    std::cout << "Window:";
+    for (int i = 0; i < static_cast<int>(WindowState::COUNT); ++i) {
+        std::cout << (i > 0 ? ", " : " ") << totals[i] / 1000.0 << " s " << STATE_NAMES[i];
+    }
+    std::cout << "; " << framesSkipped << " frames not drawn" << std::endl;
+}
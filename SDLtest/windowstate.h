@@ -0,0 +1,34 @@
+#pragma once
+#include <SDL.h>
+
+// How much of the game the player can currently see
+enum class WindowState {
+    FOCUSED,        // on screen with keyboard focus
+    UNFOCUSED,      // on screen while another window has the keyboard
+    HIDDEN,         // minimized or hidden, so nothing drawn is seen
+    COUNT
+};
+
+// Shortest gap between frames while unfocused: the game still plays, drawn at 20 fps
+const Uint32 UNFOCUSED_FRAME_MS = 50;
+// Longest a suspended game sleeps before checking the window again
+const Uint32 HIDDEN_WAIT_MS = 250;
+
+// Function to follow SDL_WINDOWEVENTs; events that lose the window's contents repaint it in full
+void windowStateEvent(const SDL_WindowEvent& e);
+
+// Function to get the current state of the window
+WindowState windowState();
+
+// Function to check whether anything drawn now would be seen
+bool windowVisible();
+
+// Function to check whether to draw this frame: always when focused, every UNFOCUSED_FRAME_MS when
+// unfocused and never when hidden
+bool windowFrameDue();
+
+// Function to sleep in SDL_WaitEventTimeout while the window is hidden; returns on any event
+void waitWhileHidden();
+
+// Function to print how long the window spent in each state and how many frames weren't drawn
+void reportWindowStates();
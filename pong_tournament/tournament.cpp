@@ -0,0 +1,172 @@
+#include "ai.h"
+#include "game.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// An AI configuration taking part in the tournament
+struct Player {
+    std::string name;
+    int reactionTicks;
+    float noise;
+    double elo;
+    int wins, draws, losses;
+};
+
+// Elo settings
+const double ELO_START = 1500.0;
+const double ELO_K = 16.0;
+
+// Function to parse "name:reaction:noise" into a player
+bool parsePlayer(const char* text, Player& player) {
+    std::string spec = text;
+    size_t first = spec.find(':');
+    size_t second = spec.find(':', first == std::string::npos ? first : first + 1);
+    if (first == std::string::npos || second == std::string::npos) {
+        return false;
+    }
+    player.name = spec.substr(0, first);
+    player.reactionTicks = std::atoi(spec.substr(first + 1, second - first - 1).c_str());
+    player.noise = static_cast<float>(std::atof(spec.substr(second + 1).c_str()));
+    player.elo = ELO_START;
+    player.wins = player.draws = player.losses = 0;
+    return true;
+}
+
+// Function to play one match to targetScore, returns 1 if left wins, -1 if right wins, 0 on the tick limit
+int playMatch(const Player& left, const Player& right, unsigned seed, int targetScore, Uint64 maxTicks, Uint64& ticks) {
+    AiController leftAi;
+    AiController rightAi;
+    initAi(leftAi, left.reactionTicks, left.noise, seed * 2 + 1);
+    initAi(rightAi, right.reactionTicks, right.noise, seed * 2 + 2);
+
+    resetPaddles();
+    leftScore = 0;
+    rightScore = 0;
+    resetBall((seed & 1) != 0);
+
+    // Same order as the game's tick: decide, move paddles, then advance the ball
+    Uint64 matchTicks = 0;
+    while (leftScore < targetScore && rightScore < targetScore && matchTicks < maxTicks) {
+        bool leftUp, leftDown, rightUp, rightDown;
+        aiDecide(leftAi, ball, leftPaddle, true, leftUp, leftDown);
+        aiDecide(rightAi, ball, rightPaddle, false, rightUp, rightDown);
+        movePaddle(leftPaddle, leftUp, leftDown);
+        movePaddle(rightPaddle, rightUp, rightDown);
+        update();
+        ++matchTicks;
+    }
+    ticks += matchTicks;
+
+    if (leftScore >= targetScore) {
+        return 1;
+    }
+    if (rightScore >= targetScore) {
+        return -1;
+    }
+    return 0;
+}
+
+// Function to apply a match result to both players' records and ratings
+void recordResult(Player& left, Player& right, int result) {
+    double expectedLeft = 1.0 / (1.0 + std::pow(10.0, (right.elo - left.elo) / 400.0));
+    double scoreLeft = result > 0 ? 1.0 : (result < 0 ? 0.0 : 0.5);
+    left.elo += ELO_K * (scoreLeft - expectedLeft);
+    right.elo -= ELO_K * (scoreLeft - expectedLeft);
+
+    if (result > 0) {
+        ++left.wins;
+        ++right.losses;
+    }
+    else if (result < 0) {
+        ++left.losses;
+        ++right.wins;
+    }
+    else {
+        ++left.draws;
+        ++right.draws;
+    }
+}
+
+// Main function
+int main(int argc, char* args[]) {
+    std::vector<Player> players;
+    int rounds = 20;
+    int targetScore = 5;
+    Uint64 maxTicks = 30000; // five minutes of game time, long rallies between equal players end as draws
+    unsigned seed = 1;
+
+    // Parse command line options
+    for (int i = 1; i < argc; ++i) {
+        Player player;
+        if (std::strcmp(args[i], "--player") == 0 && i + 1 < argc) {
+            if (!parsePlayer(args[++i], player)) {
+                std::cerr << "Expected --player name:reactionTicks:noise, got " << args[i] << std::endl;
+                return -1;
+            }
+            players.push_back(player);
+        }
+        else if (std::strcmp(args[i], "--rounds") == 0 && i + 1 < argc) {
+            rounds = std::atoi(args[++i]);
+        }
+        else if (std::strcmp(args[i], "--target") == 0 && i + 1 < argc) {
+            targetScore = std::atoi(args[++i]);
+        }
+        else if (std::strcmp(args[i], "--max-ticks") == 0 && i + 1 < argc) {
+            maxTicks = std::strtoull(args[++i], NULL, 10);
+        }
+        else if (std::strcmp(args[i], "--seed") == 0 && i + 1 < argc) {
+            seed = static_cast<unsigned>(std::strtoul(args[++i], NULL, 10));
+        }
+    }
+
+    // Default roster from unbeatable to beginner
+    if (players.empty()) {
+        const char* roster[] = { "reflex:0:0", "sharp:4:30", "steady:10:50", "sluggish:25:70", "rookie:40:90" };
+        for (const char* spec : roster) {
+            Player player;
+            parsePlayer(spec, player);
+            players.push_back(player);
+        }
+    }
+
+    // No serve pause, no sound, no window: the simulation runs flat out
+    servePauseMs = 0;
+
+    Uint64 ticks = 0;
+    int matches = 0;
+    Uint64 start = SDL_GetPerformanceCounter();
+
+    // Round robin, swapping sides every match so neither player always serves first
+    for (size_t a = 0; a < players.size(); ++a) {
+        for (size_t b = a + 1; b < players.size(); ++b) {
+            for (int round = 0; round < rounds; ++round) {
+                Player& left = (round & 1) ? players[b] : players[a];
+                Player& right = (round & 1) ? players[a] : players[b];
+                int result = playMatch(left, right, seed++, targetScore, maxTicks, ticks);
+                recordResult(left, right, result);
+                ++matches;
+            }
+        }
+    }
+
+    double seconds = static_cast<double>(SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+
+    std::sort(players.begin(), players.end(), [](const Player& a, const Player& b) { return a.elo > b.elo; });
+    std::cout << std::left << std::setw(14) << "player" << std::right << std::setw(10) << "elo"
+        << std::setw(8) << "won" << std::setw(8) << "drawn" << std::setw(8) << "lost" << std::endl;
+    for (const Player& player : players) {
+        std::cout << std::left << std::setw(14) << player.name << std::right << std::fixed << std::setprecision(1)
+            << std::setw(10) << player.elo << std::setw(8) << player.wins << std::setw(8) << player.draws
+            << std::setw(8) << player.losses << std::endl;
+    }
+
+    std::cout << std::setprecision(3) << matches << " matches, " << ticks << " ticks in " << seconds << " s ("
+        << std::setprecision(0) << matches / seconds << " matches/s, " << ticks / seconds << " ticks/s)" << std::endl;
+    return 0;
+}
@@ -0,0 +1,68 @@
+#!/usr/bin/env python3
+"""Compare two --bench-json result files and flag regressions.
+
+Usage: compare_bench.py baseline.json contender.json [--threshold PERCENT] [--metric real_time|cpu_time]
+
+Each benchmark is compared on its median (the "_median" aggregate, or the median of the
+repetitions when there is none). Exits with status 1 if any benchmark got slower by more
+than the threshold, so it can gate a CI job.
+"""
+import argparse
+import json
+import statistics
+import sys
+
+
+def load_medians(path, metric):
+    with open(path) as f:
+        data = json.load(f)
+    medians = {}
+    repetitions = {}
+    for run in data.get("benchmarks", []):
+        name = run.get("run_name", run["name"])
+        if run.get("run_type") == "aggregate":
+            if run.get("aggregate_name") == "median":
+                medians[name] = run[metric]
+        else:
+            repetitions.setdefault(name, []).append(run[metric])
+    for name, values in repetitions.items():
+        medians.setdefault(name, statistics.median(values))
+    return medians
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Flag benchmark regressions between two JSON result files.")
+    parser.add_argument("baseline")
+    parser.add_argument("contender")
+    parser.add_argument("--threshold", type=float, default=5.0, help="slowdown in percent that counts as a regression (default 5)")
+    parser.add_argument("--metric", choices=["real_time", "cpu_time"], default="real_time")
+    args = parser.parse_args()
+
+    baseline = load_medians(args.baseline, args.metric)
+    contender = load_medians(args.contender, args.metric)
+
+    regressions = 0
+    print(f"{'Benchmark':<32} {'Baseline':>12} {'Contender':>12} {'Change':>9}")
+    for name in sorted(set(baseline) | set(contender)):
+        if name not in baseline or name not in contender:
+            side = "baseline" if name not in baseline else "contender"
+            print(f"{name:<32} {'':>12} {'':>12}   missing from {side}")
+            continue
+        old, new = baseline[name], contender[name]
+        change = (new - old) / old * 100.0 if old > 0 else 0.0
+        flag = ""
+        if change > args.threshold:
+            flag = "  REGRESSION"
+            regressions += 1
+        elif change < -args.threshold:
+            flag = "  improved"
+        print(f"{name:<32} {old:>9.1f} ns {new:>9.1f} ns {change:>+8.1f}%{flag}")
+
+    if regressions:
+        print(f"{regressions} benchmark(s) slower by more than {args.threshold:g}%")
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())